@@ -1,7 +1,9 @@
 #pragma once
 
 #include "Index.h"
+#include "ThreadPool.h"
 #include <cstring>
+#include <vector>
 
 template <typename BITVECTOR>
 class Builder final {
@@ -9,14 +11,20 @@ class Builder final {
 public:
     using index_type = Index<BITVECTOR>;
     using bitvector_type = typename index_type::bitvector_type;
+    using item_type = typename index_type::Item;
 
 private:
     index_type index;
     size_t size;
+    BuilderOptions options;
 
 public:
-    Builder(size_t size_)
-        : size(size_) {}
+    Builder(size_t size_, BuilderOptions options_ = {})
+        : size(size_)
+        , options(options_) {
+
+        index.short_postings = options.short_postings;
+    }
 
     index_type&& capture() {
         index.update_internal_structures();
@@ -27,32 +35,144 @@ public:
     template <typename COLLECTION>
     void add(const COLLECTION& collection) {
         assert(size == collection.size());
-        size_t i=0;
-        for (const auto& str: collection) {
-            add(i++, str);
+        add(index, collection, 0, collection.size());
+        add_ngrams(collection, nullptr);
+    }
+
+    // Like add(collection, pool), with a pool of `threads` threads.
+    template <typename COLLECTION>
+    void add(const COLLECTION& collection, size_t threads) {
+        threads = std::min(threads, collection.size());
+        if (threads <= 1) {
+            add(collection);
+            return;
         }
+
+        // the caller is the remaining thread
+        ThreadPool pool(threads - 1);
+        add(collection, pool);
+    }
+
+    // Rows are split into contiguous ranges, one per thread of the pool and
+    // one for the caller. Each range is indexed by a separate task and then
+    // partial indexes are merged into one.
+    template <typename COLLECTION>
+    void add(const COLLECTION& collection, ThreadPool& pool) {
+        assert(size == collection.size());
+
+        const size_t n = collection.size();
+        const size_t parts = ranges(&pool, n);
+
+        // the first range goes directly to the main index
+        std::vector<index_type> partial(parts - 1);
+        pool.for_each_range(parts, 1, [this, &collection, &partial, n, parts](size_t first, size_t last) {
+            for (size_t t=first; t < last; t++) {
+                index_type& target = (t == 0) ? index : partial[t - 1];
+                add(target, collection, n * t / parts, n * (t + 1) / parts);
+                target.update_internal_structures();
+            }
+        });
+
+        for (auto& p: partial) {
+            merge(p, &pool);
+        }
+
+        add_ngrams(collection, &pool);
     }
 
 private:
-    void add(size_t row, const std::string& str) {
-        if (str.size() < 3) {
+    // 4-grams of frequent trigrams, see BuilderOptions::frequent_trigrams;
+    // trigrams have to be already indexed. The main index is only read
+    // while 4-grams are collected, thus all threads fill partial indexes.
+    template <typename COLLECTION>
+    void add_ngrams(const COLLECTION& collection, ThreadPool* pool) {
+        if (options.frequent_trigrams == 0) {
             return;
         }
 
-        for (size_t i=0; i < str.size() - 2; i++) {
-            const int32_t b0 = uint8_t(str[i + 0]);
-            const int32_t b1 = uint8_t(str[i + 1]);
-            const int32_t b2 = uint8_t(str[i + 2]);
-            const uint32_t trigram = b0 | (b1 << 8) | (b2 << 16);
-            
-            auto it = index.map.find(trigram);
-            if (it == index.map.end()) {
-                BITVECTOR bv(size);
+        index.update_internal_structures();
+        index.select_frequent_trigrams(options.frequent_trigrams);
+
+        const size_t n = collection.size();
+        const size_t parts = ranges(pool, n);
+
+        std::vector<index_type> partial(parts);
+        parallel_for(pool, parts, parts, [this, &collection, &partial, n, parts](size_t first, size_t last) {
+            for (size_t t=first; t < last; t++) {
+                for (size_t row=n * t / parts; row < n * (t + 1) / parts; row++) {
+                    index.visit_ngram_keys(collection[row], [this, &partial, t, row](uint32_t key) {
+                        set(partial[t], key, row);
+                    });
+                }
 
-                it = index.map.insert({trigram, std::move(bv)}).first;
+                partial[t].update_internal_structures();
             }
+        });
 
-            it->second.bv.set(row);
+        for (auto& p: partial) {
+            merge(p, pool);
         }
     }
+
+    template <typename COLLECTION>
+    void add(index_type& target, const COLLECTION& collection, size_t first, size_t last) {
+        for (size_t row=first; row < last; row++) {
+            add(target, row, collection[row]);
+        }
+    }
+
+    void add(index_type& target, size_t row, std::string_view str) {
+        index_type::visit_keys(str, options.short_postings, [this, &target, row](uint32_t key) {
+            set(target, key, row);
+        });
+    }
+
+    void set(index_type& target, uint32_t key, size_t row) {
+        item_type* item = target.find(key);
+        if (item == nullptr) {
+            BITVECTOR bv(size);
+
+            item = &target.insert(key, std::move(bv));
+        }
+
+        item->bv.set(row);
+    }
+
+    void merge(index_type& partial, ThreadPool* pool) {
+        // trigrams not present in the main index are simply moved,
+        // the remaining bitvectors are OR-ed in parallel
+        std::vector<std::pair<uint32_t, const item_type*>> pending;
+        for (size_t i=0; i < partial.size(); i++) {
+            const uint32_t trigram = partial.trigrams[i];
+            if (index.find(trigram) == nullptr) {
+                index.insert(trigram, std::move(partial.items[i].bv));
+            } else {
+                pending.emplace_back(trigram, &partial.items[i]);
+            }
+        }
+
+        // items of the main index are not relocated from now
+        parallel_for(pool, ranges(pool, pending.size()), pending.size(), [this, &pending](size_t first, size_t last) {
+            for (size_t i=first; i < last; i++) {
+                bitvector_type::bit_or_inplace(index.find(pending[i].first)->bv, pending[i].second->bv);
+            }
+        });
+    }
+
+    // Number of parts of n items processed by the pool and the caller.
+    static size_t ranges(const ThreadPool* pool, size_t n) {
+        const size_t threads = (pool != nullptr) ? pool->size() + 1 : 1;
+        return std::max(size_t(1), std::min(threads, n));
+    }
+
+    // Split range [0, n) into `parts` parts and call fun(first, last) for each part.
+    template <typename FUNCTION>
+    static void parallel_for(ThreadPool* pool, size_t parts, size_t n, FUNCTION fun) {
+        if (pool == nullptr || parts == 1) {
+            fun(0, n);
+            return;
+        }
+
+        pool->for_each_range(n, (n + parts - 1) / parts, fun);
+    }
 };
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "Index.h"
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+// BulkBuilder collects all (trigram, row) pairs and sorts them by trigram
+// before any bitvector is created, thus each bitvector is built at once,
+// with known cardinality.
+//
+// Sorting is a single-pass radix (counting) sort on the 24-bit trigram.
+// Rows are scanned in order, thus row ids within each bucket are sorted
+// and need not to be stored along with trigrams.
+template <typename BITVECTOR>
+class BulkBuilder final {
+
+public:
+    using index_type = Index<BITVECTOR>;
+    using bitvector_type = typename index_type::bitvector_type;
+
+private:
+    static constexpr size_t trigrams_count = 1 << 24;
+
+    struct free_deleter {
+        void operator()(size_t* ptr) const {
+            free(ptr);
+        }
+    };
+
+    index_type index;
+    size_t size;
+    BuilderOptions options;
+
+public:
+    BulkBuilder(size_t size_, BuilderOptions options_ = {})
+        : size(size_)
+        , options(options_) {
+
+        index.short_postings = options.short_postings;
+    }
+
+    index_type&& capture() {
+        index.update_internal_structures();
+        return std::move(index);
+    }
+
+public:
+    template <typename COLLECTION>
+    void add(const COLLECTION& collection) {
+        assert(size == collection.size());
+
+        add_keys(collection, [this](std::string_view str, auto callback) {
+            index_type::visit_keys(str, options.short_postings, callback);
+        });
+
+        // 4-grams of frequent trigrams, see BuilderOptions::frequent_trigrams
+        if (options.frequent_trigrams > 0) {
+            index.update_internal_structures();
+            index.select_frequent_trigrams(options.frequent_trigrams);
+            add_keys(collection, [this](std::string_view str, auto callback) {
+                index.visit_ngram_keys(str, callback);
+            });
+        }
+    }
+
+private:
+    // visit_keys(str, callback) calls callback(key) for keys of str; the
+    // index is modified only after all keys were visited.
+    template <typename COLLECTION, typename VISIT_KEYS>
+    void add_keys(const COLLECTION& collection, VISIT_KEYS visit_keys) {
+
+        // calloc'ed memory is zeroed lazily by the OS, only pages of trigrams
+        // that really occur in the collection are touched; offsets are 64-bit,
+        // a large collection has more than 2^32 (trigram, row) pairs
+        std::unique_ptr<size_t[], free_deleter> start(
+            static_cast<size_t*>(calloc(trigrams_count + 1, sizeof(size_t))));
+        if (start == nullptr) {
+            throw std::bad_alloc();
+        }
+
+        std::vector<uint32_t> trigrams;
+
+        // 1. histogram
+        for (const auto& str: collection) {
+            visit_keys(str, [&start, &trigrams](uint32_t trigram) {
+                if (start[trigram + 1]++ == 0) {
+                    trigrams.push_back(trigram);
+                }
+            });
+        }
+
+        std::sort(trigrams.begin(), trigrams.end());
+
+        // 2. bucket boundaries
+        size_t total = 0;
+        for (const uint32_t trigram: trigrams) {
+            const size_t count = start[trigram + 1];
+            start[trigram] = total;
+            total += count;
+        }
+
+        // 3. scatter row ids
+        std::vector<uint32_t> rows(total);
+        {
+            uint32_t row = 0;
+            for (const auto& str: collection) {
+                visit_keys(str, [&start, &rows, row](uint32_t trigram) {
+                    rows[start[trigram]++] = row;
+                });
+                row += 1;
+            }
+        }
+
+        // 4. create bitvectors, now start[trigram] points at the end of bucket
+        size_t first = 0;
+        for (const uint32_t trigram: trigrams) {
+            const size_t last = start[trigram];
+
+            BITVECTOR bv(size);
+            bv.reserve(last - first);
+            for (size_t i=first; i < last; i++) {
+                bv.set(rows[i]);
+            }
+
+            index.insert(trigram, std::move(bv));
+            first = last;
+        }
+    }
+};
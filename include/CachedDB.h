@@ -0,0 +1,287 @@
+#pragma once
+
+#include "IndexedDB.h"
+#include "LRUCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct CacheStats {
+    size_t result_hits = 0;
+    size_t result_misses = 0;
+    size_t intersection_hits = 0;   // all keys of a query
+    size_t prefix_hits = 0;         // keys of a query prefix
+    size_t intersection_misses = 0;
+    size_t result_bytes = 0;
+    size_t intersection_bytes = 0;
+};
+
+// IndexedDB with two LRU caches:
+//
+// * results - the number of matches for a query;
+// * intersections - candidate rows (the combined bitvector, not verified
+//   yet) keyed by the sorted set of keys of a query (trigrams and 4-grams,
+//   see Index::visit_query_keys). When a query
+//   misses, the cache is probed for prefixes of the query, from the longest
+//   one; thus "london" already cached speeds up "londonderry".
+//
+// Empty intersections are cached as well. Both caches are bounded by
+// memory limits and might be used by concurrent readers.
+template <typename COMBINER>
+class CachedDB: public IndexedDB<COMBINER> {
+
+    using base = IndexedDB<COMBINER>;
+
+public:
+    using bitvector_type = typename base::bitvector_type;
+    using index_type = typename base::index_type;
+
+    static constexpr size_t default_results_limit = 1 << 20;
+    static constexpr size_t default_intersections_limit = 64 << 20;
+
+private:
+    using bitvector_ptr = std::shared_ptr<const bitvector_type>;
+
+    mutable LRUCache<int> results;
+    mutable LRUCache<bitvector_ptr> intersections;
+
+    mutable std::atomic<size_t> result_hits{0};
+    mutable std::atomic<size_t> result_misses{0};
+    mutable std::atomic<size_t> intersection_hits{0};
+    mutable std::atomic<size_t> prefix_hits{0};
+    mutable std::atomic<size_t> intersection_misses{0};
+
+public:
+    CachedDB(const Collection& rows_, index_type&& index_,
+             size_t results_limit = default_results_limit,
+             size_t intersections_limit = default_intersections_limit)
+        : base(rows_, std::move(index_))
+        , results(results_limit)
+        , intersections(intersections_limit) {}
+
+public:
+    virtual int matches(std::string_view word) const override {
+        if (const auto cached = results.find(word)) {
+            result_hits += 1;
+            return cached.value();
+        }
+
+        result_misses += 1;
+
+        int result = 0;
+        if (word.size() <= 3) {
+            result = base::matches(word);
+        } else {
+            const bitvector_ptr bv = candidates(word);
+            if (bv != nullptr) {
+                result = this->filter_out_false_positives(*bv, word);
+            }
+        }
+
+        results.insert(word, result, sizeof(result));
+        return result;
+    }
+
+    // An unlimited query uses cached candidates, see IndexedDB::visit_matches.
+    virtual size_t visit_matches(std::string_view word, size_t limit, const DB::row_visitor& visitor) const override {
+        if (word.size() <= 3 || limit != DB::unlimited) {
+            return base::visit_matches(word, limit, visitor);
+        }
+
+        const bitvector_ptr bv = candidates(word);
+        if (bv == nullptr) {
+            return 0;
+        }
+
+        return this->visit_verified(*bv, word, limit, visitor);
+    }
+
+    // Queries go through the caches one by one.
+    virtual void matches_batch(const std::string_view* words, size_t n, int* results) const override {
+        DB::matches_batch(words, n, results);
+    }
+
+    CacheStats stats() const {
+        CacheStats s;
+        s.result_hits = result_hits;
+        s.result_misses = result_misses;
+        s.intersection_hits = intersection_hits;
+        s.prefix_hits = prefix_hits;
+        s.intersection_misses = intersection_misses;
+        s.result_bytes = results.size_in_bytes();
+        s.intersection_bytes = intersections.size_in_bytes();
+
+        return s;
+    }
+
+    void clear_caches() {
+        results.clear();
+        intersections.clear();
+    }
+
+private:
+    // Returns nullptr if there are no candidates.
+    bitvector_ptr candidates(std::string_view word) const {
+        assert(word.size() > 3);
+
+        const std::vector<uint32_t> keys = query_keys(word);
+        const key_positions sorted = sorted_keys(keys);
+
+        std::string key;
+        cache_key(sorted, keys.size(), no_key, key);
+        if (const auto cached = intersections.find(key)) {
+            intersection_hits += 1;
+            return cached.value();
+        }
+
+        // keys of a prefix of length k are the word's keys at positions
+        // [0, k - 3) and the trigram at k - 3, which is not followed by
+        // a character; a prefix having the same key as a longer one is
+        // not probed again
+        bitvector_ptr prefix;
+        size_t first = 0;
+        std::string prefix_key;
+        std::string probed = key;
+        for (size_t k=word.size() - 1; k > 3; k--) {
+            const uint32_t last = index_type::trigram(word, k - 3);
+            cache_key(sorted, k - 3, last, prefix_key);
+            if (prefix_key == probed) {
+                continue;
+            }
+
+            probed = prefix_key;
+            if (const auto cached = intersections.find(prefix_key)) {
+                if (cached.value() == nullptr) {
+                    // no rows contain the prefix
+                    prefix_hits += 1;
+                    return nullptr;
+                }
+
+                prefix = cached.value();
+                // the word's key at k - 3 is more selective if it's a 4-gram
+                first = (keys[k - 3] != last) ? k - 3 : k - 2;
+                break;
+            }
+        }
+
+        if (prefix != nullptr) {
+            prefix_hits += 1;
+        } else {
+            intersection_misses += 1;
+        }
+
+        const bitvector_ptr result = combine(keys, prefix, first);
+        // a posting list (use_count() == 0) or the prefix takes no memory
+        const bool owned = (result != nullptr && result.use_count() > 0 && result != prefix);
+        intersections.insert(key, result, owned ? result->size_in_bytes() : 0);
+        return result;
+    }
+
+    // Intersects the prefix candidates with keys starting at `first`;
+    // returns nullptr if there are no candidates. A result that is one of
+    // the inputs (e.g. picked by PickCheapest) is not copied: a posting
+    // list is referenced without ownership, it lives as long as the index.
+    bitvector_ptr combine(const std::vector<uint32_t>& keys, const bitvector_ptr& prefix, size_t first) const {
+        std::vector<const typename index_type::Item*> items;
+        for (size_t i=first; i < keys.size(); i++) {
+            const auto* item = this->index.find(keys[i]);
+            if (item == nullptr) {
+                return nullptr;
+            }
+
+            items.push_back(item);
+        }
+
+        COMBINER combiner;
+        if (prefix != nullptr) {
+            combiner.add(*prefix, prefix->cardinality());
+        }
+
+        for (const auto* item: items) {
+            if (!combiner.add(item->bv, item->get_cardinality()))
+                break;
+        }
+
+        if (!combiner.finish()) {
+            return nullptr;
+        }
+
+        const bitvector_type* value = &combiner.value();
+        if (value == prefix.get()) {
+            return prefix;
+        }
+
+        for (const auto* item: items) {
+            if (value == &item->bv) {
+                return bitvector_ptr(bitvector_ptr(), value);
+            }
+        }
+
+        return std::make_shared<const bitvector_type>(*value);
+    }
+
+    // The key at each position of word, see Index::visit_query_keys.
+    std::vector<uint32_t> query_keys(std::string_view word) const {
+        std::vector<uint32_t> keys;
+        keys.reserve(word.size() - 2);
+        this->index.visit_query_keys(word, [&keys](uint32_t key) {
+            keys.push_back(key);
+        });
+
+        return keys;
+    }
+
+    // (key, position of its first occurrence)
+    using key_positions = std::vector<std::pair<uint32_t, uint32_t>>;
+
+    // Unique keys, sorted once for cache keys of all prefixes.
+    static key_positions sorted_keys(const std::vector<uint32_t>& keys) {
+        key_positions sorted;
+        for (size_t i=0; i < keys.size(); i++) {
+            sorted.emplace_back(keys[i], i);
+        }
+
+        std::sort(sorted.begin(), sorted.end());
+        sorted.erase(std::unique(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+            return a.first == b.first;
+        }), sorted.end());
+
+        return sorted;
+    }
+
+    // keys fit 24 bits, thus this one is greater than all of them
+    static constexpr uint32_t no_key = UINT32_MAX;
+
+    // Sorted, unique keys at positions before `end` and the `extra` one
+    // (unless no_key), 3 bytes each.
+    static void cache_key(const key_positions& sorted, size_t end, uint32_t extra, std::string& key) {
+        auto append = [&key](uint32_t k) {
+            key.push_back(char(k));
+            key.push_back(char(k >> 8));
+            key.push_back(char(k >> 16));
+        };
+
+        key.clear();
+        for (const auto& [k, position]: sorted) {
+            if (extra <= k) {
+                if (extra < k || position >= end) {
+                    append(extra);
+                }
+
+                extra = no_key;
+            }
+
+            if (position < end) {
+                append(k);
+            }
+        }
+
+        if (extra != no_key) {
+            append(extra);
+        }
+    }
+};
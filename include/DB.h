@@ -1,8 +1,65 @@
 #pragma once
 
-#include <string>
+#include "Query.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <vector>
 
 class DB {
 public:
-    virtual int matches(const std::string& word) const = 0;
+    // Gets a row id, returns false to stop visiting.
+    using row_visitor = std::function<bool(size_t row)>;
+
+    static constexpr size_t unlimited = SIZE_MAX;
+
+public:
+    virtual int matches(std::string_view word) const = 0;
+
+    // Calls visitor for rows containing word, until the visitor returns
+    // false or `limit` rows were visited; returns the number of visited
+    // rows. Rows are visited in the order of index.
+    virtual size_t visit_matches(std::string_view word, size_t limit, const row_visitor& visitor) const = 0;
+
+    // Returns at most `limit` rows containing word.
+    std::vector<size_t> find_rows(std::string_view word, size_t limit = unlimited) const {
+        std::vector<size_t> rows;
+        visit_matches(word, limit, [&rows](size_t row) {
+            rows.push_back(row);
+            return true;
+        });
+
+        return rows;
+    }
+
+    // Like visit_matches, for rows matching query. Each row is checked
+    // against the whole query at most once.
+    virtual size_t visit_query(const Query& query, size_t limit, const row_visitor& visitor) const = 0;
+
+    // Returns the number of rows matching query.
+    int count(const Query& query) const {
+        return visit_query(query, unlimited, [](size_t) {
+            return true;
+        });
+    }
+
+    // Returns at most `limit` rows matching query.
+    std::vector<size_t> find_rows(const Query& query, size_t limit = unlimited) const {
+        std::vector<size_t> rows;
+        visit_query(query, limit, [&rows](size_t row) {
+            rows.push_back(row);
+            return true;
+        });
+
+        return rows;
+    }
+
+    // Sets results[i] = matches(words[i]) for i in [0, n).
+    virtual void matches_batch(const std::string_view* words, size_t n, int* results) const {
+        for (size_t i=0; i < n; i++) {
+            results[i] = matches(words[i]);
+        }
+    }
 };
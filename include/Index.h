@@ -1,53 +1,367 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
 #include <cstdint>
-#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+struct BuilderOptions {
+    // Index also single characters and pairs of characters, see Index::short_key.
+    bool short_postings = false;
+
+    // Index also 4-grams that start with one of `frequent_trigrams` trigrams
+    // of the highest cardinality, see Index::ngram_key.
+    size_t frequent_trigrams = 0;
+};
+
 
 template <typename BITVECTOR>
 class Index {
 public:
     using bitvector_type = BITVECTOR;
 
+    // Cardinality is cached, update_internal_structures() computes it for
+    // all items. The cache is atomic, thus an index might be shared by
+    // concurrent readers even if the value is computed lazily.
     struct Item {
-        mutable std::optional<size_t> cardinality;
+        static constexpr size_t unknown = SIZE_MAX;
+
+        mutable std::atomic<size_t> cardinality{unknown};
         bitvector_type bv;
 
         Item(bitvector_type&& bv_)
             : bv(std::move(bv_)) {}
 
+        Item(bitvector_type&& bv_, size_t cardinality_)
+            : cardinality(cardinality_)
+            , bv(std::move(bv_)) {}
+
+        Item(const Item& item)
+            : cardinality(item.cardinality.load(std::memory_order_relaxed))
+            , bv(item.bv) {}
+
+        Item(Item&& item) noexcept
+            : cardinality(item.cardinality.load(std::memory_order_relaxed))
+            , bv(std::move(item.bv)) {}
+
         size_t get_cardinality() const {
-            if (!cardinality.has_value()) {
-                cardinality = bv.cardinality();
+            size_t k = cardinality.load(std::memory_order_relaxed);
+            if (k == unknown) {
+                // concurrent readers might compute the same value
+                k = bv.cardinality();
+                cardinality.store(k, std::memory_order_relaxed);
             }
 
-            return cardinality.value();
+            return k;
         }
     };
 
-    using map_type = std::unordered_map<uint32_t, Item>;
-    map_type map;
+private:
+    // Trigrams are 24-bit values, they are mapped to items with a two-level
+    // table stored in a single array. The first level has 65536 entries
+    // addressed by the two higher bytes of trigram, an entry holds offset of
+    // a 256-entry page (0 = no page). The page is addressed by the lowest byte
+    // of trigram and holds 1-based index into `items` (0 = no trigram).
+    static constexpr size_t level1_size = 1 << 16;
+    static constexpr size_t page_size   = 1 << 8;
+
+    std::vector<uint32_t> table;
+
+    // an index opened from file (see IndexFile.h) uses the table
+    // stored in the mapped memory; `storage` keeps the mapping alive
+    const uint32_t* mapped_table = nullptr;
+    size_t mapped_table_size = 0;
+    std::shared_ptr<const void> storage;
 
 public:
+    std::vector<uint32_t> trigrams; // trigrams[i] is the key of items[i]
+    std::vector<Item> items;
+
+    // whether index contains postings of 1- and 2-character strings
+    bool short_postings = false;
+
+    // trigrams of at least this cardinality are followed by 4-grams in
+    // queries (0 = no 4-grams), see select_frequent_trigrams
+    size_t frequent_cardinality = 0;
+
+public:
+    Index() : table(level1_size, 0) {}
+
+    // Creates an index that uses a table stored in external memory, see open_index.
+    Index(std::shared_ptr<const void> storage_, const uint32_t* table_, size_t table_size)
+        : mapped_table(table_)
+        , mapped_table_size(table_size)
+        , storage(std::move(storage_)) {}
+
     size_t size() const {
-        return map.size();
+        return items.size();
     }
 
     size_t size_in_bytes() const {
         size_t total = 0;
 
-        total += sizeof(map);
-        total += map.size() * sizeof(Item);
-        for (const auto& item: map) {
-            total += item.second.bv.size_in_bytes();
+        total += sizeof(*this);
+        total += (mapped_table != nullptr) ? mapped_table_size * sizeof(uint32_t)
+                                           : table.capacity() * sizeof(uint32_t);
+        total += trigrams.capacity() * sizeof(uint32_t);
+        total += items.capacity() * sizeof(Item);
+        for (const auto& item: items) {
+            total += item.bv.size_in_bytes();
         }
 
         return total;
     }
 
 public:
+    const Item* find(uint32_t trigram) const {
+        const uint32_t* table = lookup_table();
+
+        const uint32_t page = table[trigram >> 8];
+        if (page == 0) {
+            return nullptr;
+        }
+
+        const uint32_t slot = table[page + (trigram & 0xff)];
+        if (slot == 0) {
+            return nullptr;
+        }
+
+        return &items[slot - 1];
+    }
+
+    Item* find(uint32_t trigram) {
+        return const_cast<Item*>(static_cast<const Index*>(this)->find(trigram));
+    }
+
+    // Feeds bitvectors of all keys of word (longer than 3 chars, see
+    // visit_query_keys) to the combiner; returns false if any key is
+    // missing or the combined result is empty.
+    template <typename COMBINER>
+    bool combine(std::string_view word, COMBINER& combiner) const {
+        assert(word.size() > 3);
+
+        std::vector<const Item*> items;
+        visit_query_keys(word, [this, &items](uint32_t key) {
+            items.push_back(find(key));
+        });
+
+        if (std::find(items.begin(), items.end(), nullptr) != items.end()) {
+            return false;
+        }
+
+        for (const Item* item: items) {
+            if (!combiner.add(item->bv, item->get_cardinality()))
+                break;
+        }
+
+        return combiner.finish();
+    }
+
+    // Returns the item of word's key having the smallest cardinality,
+    // nullptr if any key is missing.
+    const Item* cheapest(std::string_view word) const {
+        assert(word.size() >= 3);
+
+        const Item* result = nullptr;
+        bool missing = false;
+        visit_query_keys(word, [this, &result, &missing](uint32_t key) {
+            const Item* item = find(key);
+            if (item == nullptr) {
+                missing = true;
+            } else if (result == nullptr || item->get_cardinality() < result->get_cardinality()) {
+                result = item;
+            }
+        });
+
+        return missing ? nullptr : result;
+    }
+
+    // A limited query verifies rows of the smallest posting list without
+    // intersecting only if the list is at most this long; otherwise a
+    // query of common trigrams that matches few rows would verify the
+    // whole list. See IndexedDB::visit_matches.
+    static constexpr size_t verify_cheapest_limit = 4096;
+
+    // Calls callback(key) for keys whose postings contain all rows with
+    // word (at least 3 characters): its trigrams, except that a frequent
+    // trigram followed by a character is replaced by the more selective
+    // 4-gram. A word longer than 3 characters has at least two keys, as
+    // combiners expect.
+    template <typename CALLBACK>
+    void visit_query_keys(std::string_view word, CALLBACK callback) const {
+        assert(word.size() >= 3);
+
+        for (size_t i=0; i + 2 < word.size(); i++) {
+            const uint32_t key = trigram(word, i);
+            if (i + 3 < word.size() && frequent(key)) {
+                callback(ngram_key(word, i));
+            } else {
+                callback(key);
+            }
+        }
+    }
+
+    // Calls callback(key) for each 4-gram of str that starts with a frequent
+    // trigram; a key might be repeated.
+    template <typename CALLBACK>
+    void visit_ngram_keys(std::string_view str, CALLBACK callback) const {
+        for (size_t i=0; i + 3 < str.size(); i++) {
+            if (frequent(trigram(str, i))) {
+                callback(ngram_key(str, i));
+            }
+        }
+    }
+
+    // Sets frequent_cardinality, such that at least `count` trigrams (if
+    // there are so many) are frequent. Short keys are not taken into
+    // account, cardinalities have to be up to date.
+    void select_frequent_trigrams(size_t count) {
+        std::vector<size_t> cardinalities;
+        for (size_t i=0; i < items.size(); i++) {
+            if (is_trigram(trigrams[i])) {
+                cardinalities.push_back(items[i].get_cardinality());
+            }
+        }
+
+        frequent_cardinality = 0;
+        if (count == 0 || cardinalities.empty()) {
+            return;
+        }
+
+        count = std::min(count, cardinalities.size());
+        std::nth_element(cardinalities.begin(), cardinalities.begin() + (count - 1), cardinalities.end(), std::greater<size_t>());
+        frequent_cardinality = std::max(size_t(1), cardinalities[count - 1]);
+    }
+
+    static uint32_t trigram(std::string_view word, size_t i) {
+        const int32_t b0 = uint8_t(word[i + 0]);
+        const int32_t b1 = uint8_t(word[i + 1]);
+        const int32_t b2 = uint8_t(word[i + 2]);
+
+        return b0 | (b1 << 8) | (b2 << 16);
+    }
+
+    // A 1- or 2-character string is stored as a trigram padded with
+    // the null character, which never appears in rows (see Collection).
+    static uint32_t short_key(std::string_view word) {
+        assert(word.size() == 1 || word.size() == 2);
+
+        const int32_t b0 = uint8_t(word[0]);
+        const int32_t b1 = (word.size() == 2) ? uint8_t(word[1]) : 0;
+
+        return b0 | (b1 << 8);
+    }
+
+    // A 4-gram is hashed to a key having the null character in the middle,
+    // which is neither a trigram nor a short key; there are 255 * 256 such
+    // keys. Colliding 4-grams share postings, which gives only false
+    // positives.
+    static uint32_t ngram_key(std::string_view word, size_t i) {
+        const uint32_t b3 = uint8_t(word[i + 3]);
+        const uint32_t h  = (trigram(word, i) | (b3 << 24)) * uint32_t(2654435761);
+
+        const uint32_t b0 = h >> 24;
+        const uint32_t b2 = 1 + ((h >> 8) & 0xffff) % 255;
+
+        return b0 | (b2 << 16);
+    }
+
+    // Trigrams of rows have no null character, see Collection.
+    static bool is_trigram(uint32_t key) {
+        return (key & 0xff) != 0 && (key & 0xff00) != 0 && (key & 0xff0000) != 0;
+    }
+
+    // Calls callback(key) for each trigram of str and, when `short_postings`
+    // is set, for each character and pair of characters. A key might be
+    // repeated.
+    template <typename CALLBACK>
+    static void visit_keys(std::string_view str, bool short_postings, CALLBACK callback) {
+        for (size_t i=0; i + 2 < str.size(); i++) {
+            callback(trigram(str, i));
+        }
+
+        if (short_postings) {
+            for (size_t i=0; i < str.size(); i++) {
+                callback(short_key(str.substr(i, 1)));
+                if (i + 1 < str.size()) {
+                    callback(short_key(str.substr(i, 2)));
+                }
+            }
+        }
+    }
+
+    // Note: references to existing items may be invalidated.
+    Item& insert(uint32_t trigram, bitvector_type&& bv) {
+        assert(trigram < (1 << 24));
+        assert(find(trigram) == nullptr);
+        assert(mapped_table == nullptr);
+
+        size_t page = table[trigram >> 8];
+        if (page == 0) {
+            page = table.size();
+            table[trigram >> 8] = page;
+            table.resize(page + page_size, 0);
+        }
+
+        items.emplace_back(std::move(bv));
+        trigrams.push_back(trigram);
+        table[page + (trigram & 0xff)] = items.size();
+
+        return items.back();
+    }
+
+public:
+    const uint32_t* lookup_table() const {
+        return (mapped_table != nullptr) ? mapped_table : table.data();
+    }
+
+    size_t lookup_table_size() const {
+        return (mapped_table != nullptr) ? mapped_table_size : table.size();
+    }
+
+    // Checks if all entries of an external table refer to existing pages and items.
+    static bool valid_lookup_table(const uint32_t* table, size_t table_size, size_t items) {
+        if (table_size < level1_size || (table_size - level1_size) % page_size != 0) {
+            return false;
+        }
+
+        for (size_t i=0; i < level1_size; i++) {
+            const size_t page = table[i];
+            if (page != 0 && (page < level1_size || page + page_size > table_size)) {
+                return false;
+            }
+        }
+
+        for (size_t i=level1_size; i < table_size; i++) {
+            if (table[i] > items) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
     void update_internal_structures() {
-        for (auto& item: map) {
-            item.second.bv.update_internal_structures();
+        table.shrink_to_fit();
+        trigrams.shrink_to_fit();
+        items.shrink_to_fit();
+        for (auto& item: items) {
+            item.bv.update_internal_structures();
+            item.cardinality = item.bv.cardinality();
+        }
+    }
+
+private:
+    bool frequent(uint32_t trigram) const {
+        if (frequent_cardinality == 0) {
+            return false;
         }
+
+        const Item* item = find(trigram);
+        return item != nullptr && item->get_cardinality() >= frequent_cardinality;
     }
 };
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "Index.h"
+
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// On-disk index, all values are stored in the native byte order.
+//
+//    IndexFileHeader
+//    uint32_t        lookup table [header.table_size]
+//    uint32_t        trigrams [header.items]
+//    IndexFileEntry  entries [header.items]
+//    serialized bitvectors
+//
+// Entries and bitvectors are 8-byte aligned. An opened file is mapped into
+// memory, the lookup table and bitvectors refer directly to mapped pages.
+
+struct IndexFileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t file_tag;      // BITVECTOR::file_tag
+    uint64_t rows;          // size of bitvectors
+    uint64_t items;
+    uint64_t table_size;
+    uint64_t flags;         // index_file_flag_*
+    uint64_t frequent_cardinality;  // see Index::frequent_cardinality
+};
+
+struct IndexFileEntry {
+    uint64_t offset;
+    uint64_t bytes;
+    uint64_t cardinality;
+};
+
+constexpr char     index_file_magic[8]  = {'T', 'R', 'I', 'G', 'R', 'A', 'M', '\0'};
+constexpr uint32_t index_file_version   = 3;
+
+constexpr uint64_t index_file_flag_short_postings = 1;  // see Index::short_postings
+
+inline size_t index_file_align(size_t offset) {
+    return (offset + 7) & ~size_t(7);
+}
+
+
+template <typename BITVECTOR>
+void save_index(const Index<BITVECTOR>& index, const std::string& path) {
+
+    const size_t items = index.size();
+
+    IndexFileHeader header;
+    memcpy(header.magic, index_file_magic, sizeof(header.magic));
+    header.version    = index_file_version;
+    header.file_tag   = BITVECTOR::file_tag;
+    header.rows       = (items > 0) ? index.items[0].bv.size() : 0;
+    header.items      = items;
+    header.table_size = index.lookup_table_size();
+    header.flags      = index.short_postings ? index_file_flag_short_postings : 0;
+    header.frequent_cardinality = index.frequent_cardinality;
+
+    size_t offset = sizeof(header);
+    offset += header.table_size * sizeof(uint32_t);
+    offset += items * sizeof(uint32_t);
+    offset = index_file_align(offset);
+
+    std::vector<IndexFileEntry> entries(items);
+    offset += items * sizeof(IndexFileEntry);
+    for (size_t i=0; i < items; i++) {
+        const auto& item = index.items[i];
+
+        offset = index_file_align(offset);
+        entries[i].offset       = offset;
+        entries[i].bytes        = item.bv.serialized_size();
+        entries[i].cardinality  = item.get_cardinality();
+        offset += entries[i].bytes;
+    }
+
+    std::ofstream f;
+    f.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+    f.open(path, std::ios::binary | std::ios::trunc);
+
+    size_t position = 0;
+    auto write = [&f, &position](const void* ptr, size_t bytes) {
+        f.write(static_cast<const char*>(ptr), bytes);
+        position += bytes;
+    };
+
+    auto pad_to = [&write, &position](size_t target) {
+        static const char zeros[8] = {0};
+        write(zeros, target - position);
+    };
+
+    write(&header, sizeof(header));
+    write(index.lookup_table(), header.table_size * sizeof(uint32_t));
+    write(index.trigrams.data(), items * sizeof(uint32_t));
+    pad_to(index_file_align(position));
+    write(entries.data(), items * sizeof(IndexFileEntry));
+
+    std::vector<char> buffer;
+    for (size_t i=0; i < items; i++) {
+        buffer.resize(entries[i].bytes);
+        index.items[i].bv.serialize(buffer.data());
+
+        pad_to(entries[i].offset);
+        write(buffer.data(), buffer.size());
+    }
+}
+
+
+// Maps the file into memory; the file must not be modified while the index is used.
+template <typename BITVECTOR>
+Index<BITVECTOR> open_index(const std::string& path) {
+
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open " + path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        throw std::runtime_error("cannot stat " + path);
+    }
+
+    const size_t size = st.st_size;
+    if (size < sizeof(IndexFileHeader)) {
+        close(fd);
+        throw std::runtime_error(path + " is not an index file");
+    }
+
+    void* ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        throw std::runtime_error("cannot map " + path);
+    }
+
+    std::shared_ptr<const void> storage(ptr, [size](const void* p) {
+        munmap(const_cast<void*>(p), size);
+    });
+
+    const char* base = static_cast<const char*>(ptr);
+
+    IndexFileHeader header;
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, index_file_magic, sizeof(header.magic)) != 0) {
+        throw std::runtime_error(path + " is not an index file");
+    }
+
+    if (header.version != index_file_version) {
+        throw std::runtime_error(path + ": unsupported version " + std::to_string(header.version));
+    }
+
+    if (header.file_tag != BITVECTOR::file_tag) {
+        throw std::runtime_error(path + ": index was saved for another bitvector type");
+    }
+
+    const size_t table_offset    = sizeof(header);
+    const size_t trigrams_offset = table_offset + header.table_size * sizeof(uint32_t);
+    const size_t entries_offset  = index_file_align(trigrams_offset + header.items * sizeof(uint32_t));
+    const size_t entries_end     = entries_offset + header.items * sizeof(IndexFileEntry);
+    if (header.table_size > size || header.items > size || entries_end > size) {
+        throw std::runtime_error(path + ": file is truncated");
+    }
+
+    const uint32_t* table = reinterpret_cast<const uint32_t*>(base + table_offset);
+    if (!Index<BITVECTOR>::valid_lookup_table(table, header.table_size, header.items)) {
+        throw std::runtime_error(path + ": invalid lookup table");
+    }
+
+    Index<BITVECTOR> index(std::move(storage), table, header.table_size);
+    index.short_postings = (header.flags & index_file_flag_short_postings) != 0;
+    index.frequent_cardinality = header.frequent_cardinality;
+
+    const uint32_t* trigrams = reinterpret_cast<const uint32_t*>(base + trigrams_offset);
+    index.trigrams.assign(trigrams, trigrams + header.items);
+
+    const IndexFileEntry* entries = reinterpret_cast<const IndexFileEntry*>(base + entries_offset);
+    index.items.reserve(header.items);
+    for (size_t i=0; i < header.items; i++) {
+        const auto& entry = entries[i];
+        if (entry.offset % 8 != 0 || entry.offset < entries_end
+                                  || entry.offset > size
+                                  || entry.bytes > size - entry.offset) {
+            throw std::runtime_error(path + ": invalid entry");
+        }
+
+        index.items.emplace_back(BITVECTOR::view(header.rows, base + entry.offset, entry.bytes), entry.cardinality);
+    }
+
+    return index;
+}
@@ -1,8 +1,14 @@
 #pragma once
 
 #include "NaiveDB.h"
+#include "QueryPlanner.h"
 
+#include <algorithm>
 #include <functional>
+#include <numeric>
+#include <optional>
+#include <utility>
+#include <vector>
 
 template <typename COMBINER>
 class IndexedDB: public NaiveDB {
@@ -19,11 +25,15 @@ public:
         , index(std::move(index_)) {}
 
 public:
-    virtual int matches(const std::string& word) const override {
+    virtual int matches(std::string_view word) const override {
 
         const size_t n = word.size();
 
         if (n < 3) {
+            if (n > 0 && index.short_postings) {
+                return matches_short(word);
+            }
+
             return NaiveDB::matches(word);
         }
 
@@ -37,11 +47,110 @@ public:
             return 0;
         }
 
-        if constexpr (bitvector_type::custom_filter) {
-            return combiner.value().filter_out_false_positives(rows, word);
-        } else {
-            return filter_out_false_positives(combiner.value(), word);
+        return filter_out_false_positives(combiner.value(), word);
+    }
+
+    // Identical queries are evaluated once. Keys are looked up directly,
+    // Index::find is cheaper than sorting or hashing them to share lookups;
+    // one buffer of items serves all queries of the batch.
+    virtual void matches_batch(const std::string_view* words, size_t n, int* results) const override {
+
+        using item_type = typename index_type::Item;
+
+        std::vector<uint32_t> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [words](uint32_t a, uint32_t b) {
+            return words[a] < words[b];
+        });
+
+        std::vector<const item_type*> items;
+        for (size_t i=0; i < n; /**/) {
+            const std::string_view word = words[order[i]];
+
+            size_t j = i + 1;
+            while (j < n && words[order[j]] == word) {
+                j += 1;
+            }
+
+            int result = 0;
+            if (word.size() <= 3) {
+                result = matches(word);
+            } else {
+                items.clear();
+                index.visit_query_keys(word, [this, &items](uint32_t key) {
+                    items.push_back(index.find(key));
+                });
+
+                COMBINER combiner;
+                if (get_matches_longer(items.data(), items.size(), combiner)) {
+                    result = filter_out_false_positives(combiner.value(), word);
+                }
+            }
+
+            for (size_t k=i; k < j; k++) {
+                results[order[k]] = result;
+            }
+
+            i = j;
+        }
+    }
+
+    // A limited query verifies rows from the smallest posting list until
+    // the limit is reached, thus no intersection is done and its latency
+    // does not depend on the total number of matches. A long list is
+    // intersected first (see Index::verify_cheapest_limit), the
+    // verification still stops at the limit.
+    virtual size_t visit_matches(std::string_view word, size_t limit, const row_visitor& visitor) const override {
+
+        if (word.size() < 3) {
+            if (word.size() > 0 && index.short_postings) {
+                const auto* item = index.find(index_type::short_key(word));
+                return (item != nullptr) ? visit_verified(item->bv, word, limit, visitor) : 0;
+            }
+
+            return NaiveDB::visit_matches(word, limit, visitor);
+        }
+
+        if (word.size() == 3 || limit != unlimited) {
+            const auto* item = index.cheapest(word);
+            if (item == nullptr) {
+                return 0;
+            }
+
+            if (word.size() == 3 || item->get_cardinality() <= index_type::verify_cheapest_limit) {
+                return visit_verified(item->bv, word, limit, visitor);
+            }
         }
+
+        COMBINER combiner;
+        if (!get_matches_longer(word, combiner)) {
+            return 0;
+        }
+
+        return visit_verified(combiner.value(), word, limit, visitor);
+    }
+
+    // The query is planned over postings, see QueryPlanner; then
+    // each candidate row is verified once against the whole query.
+    virtual size_t visit_query(const Query& query, size_t limit, const row_visitor& visitor) const override {
+
+        if (query.get_kind() == Query::kind::term) {
+            return visit_matches(query.text(), limit, visitor);
+        }
+
+        QueryPlanner<COMBINER> planner(index);
+        const bitvector_type* candidates = nullptr;
+        if (!planner.candidates(query, candidates)) {
+            return NaiveDB::visit_query(query, limit, visitor);
+        }
+
+        if (candidates == nullptr) {
+            return 0;
+        }
+
+        return visit_filtered(*candidates, limit, visitor, [&query](std::string_view row) {
+            return query.matches(row);
+        });
     }
 
 public:
@@ -50,60 +159,111 @@ public:
     }
 
 protected:
-    size_t matches_len3(const std::string& word) const {
+    size_t matches_len3(std::string_view word) const {
 
         assert(word.size() == 3);
 
-        const int32_t b0 = uint8_t(word[0]);
-        const int32_t b1 = uint8_t(word[1]);
-        const int32_t b2 = uint8_t(word[2]);
-        const uint32_t trigram = b0 | (b1 << 8) | (b2 << 16);
+        // not a trigram, the key might be a short key or a 4-gram key
+        if (has_null_character(word)) {
+            return 0;
+        }
 
-        auto it = index.map.find(trigram);
-        if (it == index.map.end()) {
+        const auto* item = index.find(trigram(word, 0));
+        if (item == nullptr) {
             return 0;
         } else {
-            return it->second.bv.cardinality();
+            return item->get_cardinality();
         }
     }
 
-    bool get_matches_longer(const std::string& word, COMBINER& combiner) const {
+    // Postings of short strings are exact.
+    size_t matches_short(std::string_view word) const {
 
-        assert(word.size() > 3);
+        if (has_null_character(word)) {
+            return 0;
+        }
 
-        for (size_t i=0; i < word.size() - 2; i++) {
-            const int32_t b0 = uint8_t(word[i + 0]);
-            const int32_t b1 = uint8_t(word[i + 1]);
-            const int32_t b2 = uint8_t(word[i + 2]);
-            const uint32_t trigram = b0 | (b1 << 8) | (b2 << 16);
+        const auto* item = index.find(index_type::short_key(word));
+        if (item == nullptr) {
+            return 0;
+        } else {
+            return item->get_cardinality();
+        }
+    }
+
+    bool get_matches_longer(std::string_view word, COMBINER& combiner) const {
+
+        return index.combine(word, combiner);
+    }
 
-            auto it = index.map.find(trigram);
-            if (it == index.map.end()) {
+    // items are already looked up, see matches_batch
+    bool get_matches_longer(const typename index_type::Item* const* items, size_t n, COMBINER& combiner) const {
+
+        for (size_t i=0; i < n; i++) {
+            if (items[i] == nullptr) {
                 return false;
             }
+        }
 
-            if (!combiner.add(it->second.bv))
+        for (size_t i=0; i < n; i++) {
+            if (!combiner.add(items[i]->bv, items[i]->get_cardinality()))
                 break;
         }
 
-        return combiner.has_value();
+        return combiner.finish();
     }
 
-    size_t filter_out_false_positives(const bitvector_type& bv, const std::string& word) const {
+    static uint32_t trigram(std::string_view word, size_t i) {
+        return index_type::trigram(word, i);
+    }
+
+    size_t filter_out_false_positives(const bitvector_type& bv, std::string_view word) const {
 
         size_t count = 0;
-        auto visitor = [&word, &count, this](size_t index) {
-            if (std::strstr(rows[index].c_str(), word.c_str())) {
-                count += 1;
+        auto visitor = [&word, &count, this](const uint32_t* ids, size_t n) {
+            for (size_t i=0; i < n; i++) {
+                count += substring_contains(rows[ids[i]], word);
             }
         };
 
-        bv.visit(visitor);
+        bv.visit_batches(visitor);
+        return count;
+    }
+
+    size_t visit_verified(const bitvector_type& bv, std::string_view word, size_t limit, const row_visitor& visitor) const {
+
+        return visit_filtered(bv, limit, visitor, [&word](std::string_view row) {
+            return substring_contains(row, word);
+        });
+    }
+
+    // Visits rows of bv for which predicate(row) holds. Once the visitor
+    // stops, the remaining batches are not decoded.
+    template <typename PREDICATE>
+    size_t visit_filtered(const bitvector_type& bv, size_t limit, const row_visitor& visitor, PREDICATE predicate) const {
+
+        size_t count = 0;
+        bool stop = (limit == 0);
+        if (stop) {
+            return count;
+        }
+
+        bv.visit_batches_until([&predicate, &limit, &visitor, &count, &stop, this](const uint32_t* ids, size_t n) {
+            for (size_t i=0; i < n && !stop; i++) {
+                if (predicate(rows[ids[i]])) {
+                    count += 1;
+                    stop = !visitor(ids[i]) || count == limit;
+                }
+            }
+
+            return !stop;
+        });
+
         return count;
     }
 
-    size_t filter_out_false_positives(size_t index, const std::string& word) const {
+    size_t filter_out_false_positives(size_t index, std::string_view word) const {
 
-        return std::strstr(rows[index].c_str(), word.c_str()) != nullptr; 
+        return substring_contains(rows[index], word);
     }
 };
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Thread-safe LRU cache with string keys, bounded by the total size of
+// entries. Keys are distributed among shards, each shard has own lock,
+// LRU list and an equal part of the capacity.
+template <typename VALUE>
+class LRUCache final {
+
+    struct Entry {
+        std::string key;
+        VALUE value;
+        size_t bytes;
+    };
+
+    using list_type = std::list<Entry>;
+
+    struct Shard {
+        std::mutex mutex;
+        list_type entries; // the most recently used first
+        std::unordered_map<std::string_view, typename list_type::iterator> map; // keys refer to entries
+        size_t bytes = 0;
+    };
+
+    // approximate cost of list and map nodes
+    static constexpr size_t entry_overhead = sizeof(Entry) + 64;
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    size_t shard_capacity;
+
+public:
+    LRUCache(size_t capacity, size_t shards_count = 16) {
+        shards_count = std::max(size_t(1), shards_count);
+        for (size_t i=0; i < shards_count; i++) {
+            shards.emplace_back(new Shard);
+        }
+
+        shard_capacity = capacity / shards_count;
+    }
+
+    LRUCache(const LRUCache&) = delete;
+    LRUCache& operator=(const LRUCache&) = delete;
+
+    std::optional<VALUE> find(std::string_view key) {
+        Shard& shard = get_shard(key);
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) {
+            return std::nullopt;
+        }
+
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return it->second->value;
+    }
+
+    // `bytes` is the size of value; an entry larger than a shard
+    // capacity is not stored.
+    void insert(std::string_view key, VALUE value, size_t bytes) {
+        bytes += key.size() + entry_overhead;
+        if (bytes > shard_capacity) {
+            return;
+        }
+
+        Shard& shard = get_shard(key);
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it != shard.map.end()) {
+            // inserted meanwhile by another thread
+            return;
+        }
+
+        while (shard.bytes + bytes > shard_capacity) {
+            const Entry& last = shard.entries.back();
+            shard.bytes -= last.bytes;
+            shard.map.erase(last.key);
+            shard.entries.pop_back();
+        }
+
+        shard.entries.push_front({std::string(key), std::move(value), bytes});
+        shard.map.emplace(shard.entries.front().key, shard.entries.begin());
+        shard.bytes += bytes;
+    }
+
+    void clear() {
+        for (auto& shard: shards) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            shard->map.clear();
+            shard->entries.clear();
+            shard->bytes = 0;
+        }
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (auto& shard: shards) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            total += shard->entries.size();
+        }
+
+        return total;
+    }
+
+    size_t size_in_bytes() const {
+        size_t total = 0;
+        for (auto& shard: shards) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            total += shard->bytes;
+        }
+
+        return total;
+    }
+
+    size_t capacity() const {
+        return shard_capacity * shards.size();
+    }
+
+private:
+    Shard& get_shard(std::string_view key) {
+        return *shards[std::hash<std::string_view>()(key) % shards.size()];
+    }
+};
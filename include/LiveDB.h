@@ -0,0 +1,627 @@
+#pragma once
+
+#include "DB.h"
+#include "Builder.h"
+#include "QueryPlanner.h"
+#include "substring.h"
+#include "types.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Database that accepts inserts and deletes of rows.
+//
+// Rows are kept in segments. New rows go to the delta segment, which is
+// not indexed and is searched by scanning; when it grows to `delta_limit`
+// rows, it gets an index and becomes an immutable segment. Deleted rows
+// are recorded in per-segment tombstone lists and skipped by queries.
+//
+// Segments are merged automatically, like carries of a binary counter:
+// the newest immutable segment is merged with the previous one as long as
+// that one is not larger. There are O(log n) segments and each row is
+// merged O(log n) times. compact() merges all immutable segments into one,
+// dropping deleted rows; it might be run in a background thread. Segments
+// don't grow past max_segment_size rows, the range of the bitvector type.
+//
+// Segments and tombstones form an immutable snapshot. An update creates
+// a new snapshot that shares unchanged segments and publishes it atomically,
+// thus a query sees a consistent state and is never blocked by updates.
+// The delta segment is append-only storage shared by snapshots, each of
+// them sees its first rows; an insert copies only the list of segments.
+// The insert that fills the delta segment only queues it: a background
+// worker thread builds indexes and merges segments, until then the full
+// delta segment is scanned. The cost of delete is bounded by the number
+// of deleted rows in a segment.
+template <typename COMBINER>
+class LiveDB: public DB {
+public:
+    using bitvector_type = typename COMBINER::bitvector_type;
+    using index_type = Index<bitvector_type>;
+
+    static constexpr size_t default_delta_limit = 4096;
+
+    // ids of rows in a segment start from zero
+    static constexpr size_t max_segment_size = bitvector_type::max_index + 1;
+
+private:
+    struct Segment {
+        std::vector<size_t> ids;            // ascending row ids, as returned by insert()
+        Collection rows;
+        index_type index;
+    };
+
+    // Rows of the delta segment. Slots are filled in order by insert()
+    // before a snapshot that sees them is published, and they never move,
+    // thus readers of older snapshots are not affected.
+    struct Delta {
+        std::unique_ptr<size_t[]> ids;
+        std::unique_ptr<std::string[]> rows;
+
+        explicit Delta(size_t capacity)
+            : ids(new size_t[capacity])
+            , rows(new std::string[capacity]) {}
+    };
+
+    struct Part {
+        std::shared_ptr<const Segment> segment;   // nullptr for a delta segment
+        std::shared_ptr<const Delta> delta;
+        size_t size = 0;                          // rows seen by the snapshot
+        std::shared_ptr<const std::vector<uint32_t>> deleted; // sorted positions in the segment
+
+        const index_type* index() const {
+            return (segment != nullptr) ? &segment->index : nullptr;
+        }
+
+        std::string_view row(size_t pos) const {
+            return (segment != nullptr) ? segment->rows[pos] : std::string_view(delta->rows[pos]);
+        }
+
+        size_t id(size_t pos) const {
+            return (segment != nullptr) ? segment->ids[pos] : delta->ids[pos];
+        }
+
+        bool live(size_t pos) const {
+            return !std::binary_search(deleted->begin(), deleted->end(), pos);
+        }
+
+        // Position of the row with given id, `size` if there is none.
+        size_t find(size_t id) const {
+            size_t lo = 0;
+            size_t hi = size;
+            while (lo < hi) {
+                const size_t mid = lo + (hi - lo) / 2;
+                if (this->id(mid) < id) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+
+            return (lo < size && this->id(lo) == id) ? lo : size;
+        }
+    };
+
+public:
+    class Snapshot {
+        friend class LiveDB;
+
+        std::vector<Part> parts;    // ordered by row ids, the last one is the delta segment
+        size_t live_rows = 0;
+
+    public:
+        int matches(std::string_view word) const {
+            size_t count = 0;
+            for (const auto& part: parts) {
+                count += matches(part, word);
+            }
+
+            return count;
+        }
+
+        // Row ids are visited in ascending order, see DB::visit_matches.
+        size_t visit_matches(std::string_view word, size_t limit, const row_visitor& visitor) const {
+            size_t count = 0;
+            bool stop = (limit == 0);
+            for (size_t i=0; i < parts.size() && !stop; i++) {
+                const size_t remaining = (limit == unlimited) ? unlimited : limit - count;
+                count += visit_matches(parts[i], word, remaining, visitor, stop);
+            }
+
+            return count;
+        }
+
+        // See DB::visit_query.
+        size_t visit_query(const Query& query, size_t limit, const row_visitor& visitor) const {
+            size_t count = 0;
+            bool stop = (limit == 0);
+            for (size_t i=0; i < parts.size() && !stop; i++) {
+                const Part& part = parts[i];
+
+                auto verify = [&](const uint32_t* ids, size_t n) {
+                    for (size_t j=0; j < n && !stop; j++) {
+                        if (part.live(ids[j]) && query.matches(part.row(ids[j]))) {
+                            count += 1;
+                            stop = !visitor(part.id(ids[j])) || count == limit;
+                        }
+                    }
+
+                    return !stop;
+                };
+
+                std::optional<QueryPlanner<COMBINER>> planner;
+                if (part.index() != nullptr) {
+                    planner.emplace(*part.index());
+                }
+
+                const bitvector_type* candidates = nullptr;
+                if (!planner.has_value() || !planner->candidates(query, candidates)) {
+                    for (uint32_t j=0; j < part.size && !stop; j++) {
+                        verify(&j, 1);
+                    }
+                } else if (candidates != nullptr) {
+                    candidates->visit_batches_until(verify);
+                }
+            }
+
+            return count;
+        }
+
+        size_t size() const {
+            return live_rows;
+        }
+
+        size_t segments_count() const {
+            return parts.size();
+        }
+
+    private:
+        static size_t matches(const Part& part, std::string_view word) {
+            const index_type* index = part.index();
+
+            if (index == nullptr || word.size() < 3) {
+                size_t count = 0;
+                for (size_t i=0; i < part.size; i++) {
+                    count += substring_contains(part.row(i), word) && part.live(i);
+                }
+
+                return count;
+            }
+
+            if (word.size() == 3) {
+                if (has_null_character(word)) {
+                    return 0;
+                }
+
+                const auto* item = index->find(index_type::trigram(word, 0));
+                if (item == nullptr) {
+                    return 0;
+                }
+
+                size_t count = item->get_cardinality();
+                for (const uint32_t pos: *part.deleted) {
+                    count -= substring_contains(part.row(pos), word);
+                }
+
+                return count;
+            }
+
+            COMBINER combiner;
+            if (!index->combine(word, combiner)) {
+                return 0;
+            }
+
+            size_t count = 0;
+            combiner.value().visit_batches([&part, &word, &count](const uint32_t* ids, size_t n) {
+                for (size_t i=0; i < n; i++) {
+                    count += part.live(ids[i]) && substring_contains(part.row(ids[i]), word);
+                }
+            });
+
+            return count;
+        }
+
+        // A limited query verifies rows of the smallest posting list,
+        // see IndexedDB::visit_matches.
+        static size_t visit_matches(const Part& part, std::string_view word, size_t limit, const row_visitor& visitor, bool& stop) {
+            const index_type* index = part.index();
+
+            size_t count = 0;
+            auto verify = [&](const uint32_t* ids, size_t n) {
+                for (size_t i=0; i < n && !stop; i++) {
+                    if (part.live(ids[i]) && substring_contains(part.row(ids[i]), word)) {
+                        count += 1;
+                        stop = !visitor(part.id(ids[i])) || count == limit;
+                    }
+                }
+
+                return !stop;
+            };
+
+            if (index == nullptr || word.size() < 3) {
+                for (uint32_t i=0; i < part.size && !stop; i++) {
+                    verify(&i, 1);
+                }
+            } else {
+                const auto* item = (word.size() == 3 || limit != unlimited) ? index->cheapest(word) : nullptr;
+                if (item != nullptr && (word.size() == 3 || item->get_cardinality() <= index_type::verify_cheapest_limit)) {
+                    item->bv.visit_batches_until(verify);
+                } else if (word.size() > 3) {
+                    COMBINER combiner;
+                    if (index->combine(word, combiner)) {
+                        combiner.value().visit_batches_until(verify);
+                    }
+                }
+            }
+
+            return count;
+        }
+    };
+
+private:
+    const size_t delta_limit;
+    std::shared_ptr<const Snapshot> current;    // accessed with atomic_load/atomic_store
+
+    std::mutex update_mutex;        // serializes publishing of snapshots
+    std::mutex compaction_mutex;    // serializes merging of segments
+    size_t next_id = 0;             // guarded by update_mutex
+    std::shared_ptr<Delta> delta;   // guarded by update_mutex
+
+    // full delta segments waiting for the worker, guarded by worker_mutex
+    std::mutex worker_mutex;
+    std::condition_variable worker_wakeup;
+    std::condition_variable worker_idle;
+    std::deque<std::shared_ptr<const Delta>> full_deltas;
+    bool worker_busy = false;
+    bool stopping = false;
+    std::thread worker;
+
+public:
+    LiveDB(size_t delta_limit_ = default_delta_limit)
+        : delta_limit(delta_limit_) {
+
+        if (delta_limit == 0) {
+            throw std::invalid_argument("LiveDB: delta limit must be greater than zero");
+        }
+
+        if (delta_limit > max_segment_size) {
+            throw std::invalid_argument("LiveDB: delta limit exceeds the range of the bitvector type");
+        }
+
+        delta = std::make_shared<Delta>(delta_limit);
+
+        auto snapshot = std::make_shared<Snapshot>();
+        snapshot->parts.push_back(empty_delta(delta));
+        publish(std::move(snapshot));
+
+        worker = std::thread([this] { run_worker(); });
+    }
+
+    // Queued delta segments that are not indexed yet are dropped.
+    ~LiveDB() {
+        {
+            std::lock_guard<std::mutex> lock(worker_mutex);
+            stopping = true;
+        }
+
+        worker_wakeup.notify_all();
+        worker.join();
+    }
+
+    LiveDB(const LiveDB&) = delete;
+    LiveDB& operator=(const LiveDB&) = delete;
+
+public:
+    virtual int matches(std::string_view word) const override {
+        return snapshot()->matches(word);
+    }
+
+    // Visits ids returned by insert().
+    virtual size_t visit_matches(std::string_view word, size_t limit, const row_visitor& visitor) const override {
+        return snapshot()->visit_matches(word, limit, visitor);
+    }
+
+    virtual size_t visit_query(const Query& query, size_t limit, const row_visitor& visitor) const override {
+        return snapshot()->visit_query(query, limit, visitor);
+    }
+
+    // The current state; it's not affected by later updates.
+    std::shared_ptr<const Snapshot> snapshot() const {
+        return std::atomic_load(&current);
+    }
+
+    size_t size() const {
+        return snapshot()->size();
+    }
+
+    // Returns id of the new row. The insert that fills the delta segment
+    // hands it over to the worker, see the class comment. Rows can't
+    // contain the null character, see Collection.
+    size_t insert(std::string_view row) {
+        if (has_null_character(row)) {
+            throw std::invalid_argument("LiveDB: a row contains the null character");
+        }
+
+        std::shared_ptr<const Delta> full;
+        size_t id;
+        {
+            std::lock_guard<std::mutex> lock(update_mutex);
+
+            auto next = std::make_shared<Snapshot>(*snapshot());
+            Part& last = next->parts.back();
+            assert(last.delta == delta && last.size < delta_limit);
+
+            id = next_id++;
+            delta->ids[last.size] = id;
+            delta->rows[last.size] = std::string(row);
+            last.size += 1;
+            next->live_rows += 1;
+
+            if (last.size == delta_limit) {
+                full = std::move(delta);
+                delta = std::make_shared<Delta>(delta_limit);
+                next->parts.push_back(empty_delta(delta));
+            }
+
+            publish(std::move(next));
+        }
+
+        if (full != nullptr) {
+            {
+                std::lock_guard<std::mutex> lock(worker_mutex);
+                full_deltas.push_back(std::move(full));
+            }
+
+            worker_wakeup.notify_one();
+        }
+
+        return id;
+    }
+
+    // Waits until the worker has indexed all full delta segments and
+    // finished merging.
+    void wait_for_worker() {
+        std::unique_lock<std::mutex> lock(worker_mutex);
+        worker_idle.wait(lock, [this] { return full_deltas.empty() && !worker_busy; });
+    }
+
+    // Returns false if there is no such row.
+    bool remove(size_t id) {
+        std::lock_guard<std::mutex> lock(update_mutex);
+
+        const auto snap = snapshot();
+        const auto& parts = snap->parts;
+
+        // the last part with the first id not greater than id
+        auto it = std::upper_bound(parts.begin(), parts.end(), id, [](size_t id, const Part& part) {
+            return part.size == 0 || id < part.id(0);
+        });
+
+        if (it == parts.begin()) {
+            return false;
+        }
+
+        const size_t p = std::prev(it) - parts.begin();
+        const uint32_t pos = parts[p].find(id);
+        if (pos == parts[p].size) {
+            return false;
+        }
+
+        const auto& deleted = *parts[p].deleted;
+        const auto d = std::lower_bound(deleted.begin(), deleted.end(), pos);
+        if (d != deleted.end() && *d == pos) {
+            return false;
+        }
+
+        auto tombstones = std::make_shared<std::vector<uint32_t>>();
+        tombstones->reserve(deleted.size() + 1);
+        tombstones->insert(tombstones->end(), deleted.begin(), d);
+        tombstones->push_back(pos);
+        tombstones->insert(tombstones->end(), d, deleted.end());
+
+        auto next = std::make_shared<Snapshot>(*snap);
+        next->parts[p].deleted = std::move(tombstones);
+        next->live_rows -= 1;
+
+        publish(std::move(next));
+        return true;
+    }
+
+    // Merges all immutable segments into one (or into the leading ones that
+    // fit max_segment_size), dropping deleted rows; returns false if there
+    // was nothing to do. Queries and updates are not blocked
+    // while the new segment is built.
+    bool compact() {
+        std::lock_guard<std::mutex> compaction(compaction_mutex);
+
+        const auto snap = snapshot();
+
+        // a delta segment not indexed yet ends the range
+        size_t k = 0;
+        size_t rows = 0;
+        bool has_deleted = false;
+        while (k < snap->parts.size() && snap->parts[k].index() != nullptr && rows + snap->parts[k].size <= max_segment_size) {
+            has_deleted |= !snap->parts[k].deleted->empty();
+            rows += snap->parts[k].size;
+            k += 1;
+        }
+
+        if (k == 0 || (k == 1 && !has_deleted)) {
+            return false;
+        }
+
+        merge(snap, 0, k);
+        return true;
+    }
+
+private:
+    void publish(std::shared_ptr<const Snapshot> snapshot) {
+        std::atomic_store(&current, std::move(snapshot));
+    }
+
+    static std::shared_ptr<const std::vector<uint32_t>> no_deleted() {
+        static const auto empty = std::make_shared<const std::vector<uint32_t>>();
+        return empty;
+    }
+
+    static Part empty_delta(std::shared_ptr<const Delta> delta) {
+        return {nullptr, std::move(delta), 0, no_deleted()};
+    }
+
+    // Indexes a full delta segment and replaces it in the current snapshot.
+    void freeze(const std::shared_ptr<const Delta>& full) {
+        auto segment = std::make_shared<Segment>();
+        segment->ids.assign(full->ids.get(), full->ids.get() + delta_limit);
+        for (size_t i=0; i < delta_limit; i++) {
+            segment->rows.emplace_back(full->rows[i]);
+        }
+
+        Builder<bitvector_type> builder(segment->rows.size());
+        builder.add(segment->rows);
+        segment->index = builder.capture();
+
+        // rows are in the same order, thus tombstones remain valid
+        std::lock_guard<std::mutex> lock(update_mutex);
+        auto next = std::make_shared<Snapshot>(*snapshot());
+        for (auto& part: next->parts) {
+            if (part.delta == full) {
+                part.segment = segment;
+                part.delta = nullptr;
+            }
+        }
+
+        publish(std::move(next));
+    }
+
+    // Indexes full delta segments in order of inserts and merges segments.
+    void run_worker() {
+        std::unique_lock<std::mutex> lock(worker_mutex);
+        while (true) {
+            worker_wakeup.wait(lock, [this] { return stopping || !full_deltas.empty(); });
+            if (stopping) {
+                return;
+            }
+
+            const auto full = std::move(full_deltas.front());
+            full_deltas.pop_front();
+            worker_busy = true;
+            lock.unlock();
+
+            freeze(full);
+            merge_tail();
+
+            lock.lock();
+            worker_busy = false;
+            if (full_deltas.empty()) {
+                worker_idle.notify_all();
+            }
+        }
+    }
+
+    // Merges the newest immutable segment with the previous one while
+    // that one is not larger, see the class comment.
+    void merge_tail() {
+        std::lock_guard<std::mutex> compaction(compaction_mutex);
+
+        while (true) {
+            const auto snap = snapshot();
+            const auto& parts = snap->parts;
+
+            size_t last = parts.size();
+            while (last > 0 && parts[last - 1].index() == nullptr) {
+                last -= 1;
+            }
+
+            if (last < 2 || parts[last - 2].index() == nullptr || parts[last - 2].size > parts[last - 1].size) {
+                return;
+            }
+
+            if (parts[last - 2].size + parts[last - 1].size > max_segment_size) {
+                return;
+            }
+
+            merge(snap, last - 2, 2);
+        }
+    }
+
+    // Replaces parts [first, first + k) of snap, which are immutable
+    // segments, with one segment; compaction_mutex has to be locked.
+    void merge(const std::shared_ptr<const Snapshot>& snap, size_t first, size_t k) {
+        std::vector<Part> merged;
+        add_merged(merged, snap->parts.data() + first, k);
+
+        std::lock_guard<std::mutex> lock(update_mutex);
+        const auto now = snapshot();
+
+        // Updates only append parts or index a delta segment in place,
+        // thus parts [first, first + k) are still the merged ones. Rows
+        // deleted in the meantime are marked in the new segment.
+        std::vector<uint32_t> deleted;
+        for (size_t i=first; i < first + k; i++) {
+            assert(now->parts[i].segment == snap->parts[i].segment);
+            const auto& before = *snap->parts[i].deleted;
+            const auto& after  = *now->parts[i].deleted;
+            if (after.size() == before.size()) {
+                continue;
+            }
+
+            std::vector<uint32_t> diff;
+            std::set_difference(after.begin(), after.end(), before.begin(), before.end(), std::back_inserter(diff));
+            for (const uint32_t pos: diff) {
+                deleted.push_back(merged.front().find(snap->parts[i].id(pos)));
+            }
+        }
+
+        if (!deleted.empty()) {
+            merged.front().deleted = std::make_shared<const std::vector<uint32_t>>(std::move(deleted));
+        }
+
+        auto next = std::make_shared<Snapshot>();
+        next->parts.assign(now->parts.begin(), now->parts.begin() + first);
+        next->parts.insert(next->parts.end(), merged.begin(), merged.end());
+        next->parts.insert(next->parts.end(), now->parts.begin() + first + k, now->parts.end());
+        next->live_rows = now->live_rows;
+
+        publish(std::move(next));
+    }
+
+    // Builds an indexed segment from live rows of parts and appends it
+    // to `out`; nothing is appended if all rows were deleted.
+    static void add_merged(std::vector<Part>& out, const Part* parts, size_t n) {
+        auto segment = std::make_shared<Segment>();
+        for (size_t i=0; i < n; i++) {
+            const Part& part = parts[i];
+            const auto& deleted = *part.deleted;
+
+            auto d = deleted.begin();
+            for (size_t j=0; j < part.size; j++) {
+                if (d != deleted.end() && *d == j) {
+                    ++d;
+                    continue;
+                }
+
+                segment->ids.push_back(part.id(j));
+                segment->rows.emplace_back(part.row(j));
+            }
+        }
+
+        if (segment->rows.empty()) {
+            return;
+        }
+
+        Builder<bitvector_type> builder(segment->rows.size());
+        builder.add(segment->rows);
+        segment->index = builder.capture();
+
+        const size_t size = segment->rows.size();
+        out.push_back({std::move(segment), nullptr, size, no_deleted()});
+    }
+};
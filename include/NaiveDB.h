@@ -1,6 +1,7 @@
 #pragma once
 
 #include "types.h"
+#include "substring.h"
 
 class NaiveDB : public DB {
 protected:
@@ -11,11 +12,11 @@ public:
         : rows(rows_) {}
 
 public:
-    virtual int matches(const std::string& word) const override {
+    virtual int matches(std::string_view word) const override {
         int n = 0;
         int i = 0;
         for (const auto& row: rows) {
-            if (row.find(word) != std::string::npos) {
+            if (substring_contains(row, word)) {
                 n += 1;
             }
 
@@ -24,4 +25,32 @@ public:
 
         return n;
     }
+
+    virtual size_t visit_matches(std::string_view word, size_t limit, const row_visitor& visitor) const override {
+        size_t n = 0;
+        for (size_t i=0; i < rows.size() && n < limit; i++) {
+            if (substring_contains(rows[i], word)) {
+                n += 1;
+                if (!visitor(i)) {
+                    break;
+                }
+            }
+        }
+
+        return n;
+    }
+
+    virtual size_t visit_query(const Query& query, size_t limit, const row_visitor& visitor) const override {
+        size_t n = 0;
+        for (size_t i=0; i < rows.size() && n < limit; i++) {
+            if (query.matches(rows[i])) {
+                n += 1;
+                if (!visitor(i)) {
+                    break;
+                }
+            }
+        }
+
+        return n;
+    }
 };
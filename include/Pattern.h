@@ -0,0 +1,579 @@
+#pragma once
+
+#include "Query.h"
+
+#include <cctype>
+#include <memory>
+#include <optional>
+#include <regex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Pattern queries: a pattern is compiled into a matcher and a query of
+// literals that every matching row has to contain (see Query::predicate),
+// thus the index narrows candidates and the matcher checks only them.
+// A pattern containing a literal run of 3 or more characters is not
+// a full scan.
+
+
+// SQL LIKE: '%' matches any sequence of characters, '_' a single character,
+// '\' escapes the next character. The whole row has to match.
+class like_matcher {
+
+    // a part of the pattern between '%'; any[i] is set for '_' at text[i]
+    struct Segment {
+        std::string text;
+        std::vector<bool> any;
+        bool has_any = false;
+    };
+
+    std::vector<Segment> segments;  // there is '%' between segments
+
+public:
+    like_matcher(std::string_view pattern) {
+        segments.emplace_back();
+        for (size_t i=0; i < pattern.size(); i++) {
+            char c = pattern[i];
+            if (c == '%') {
+                segments.emplace_back();
+                continue;
+            }
+
+            Segment& segment = segments.back();
+            const bool any = (c == '_');
+            if (c == '\\' && i + 1 < pattern.size()) {
+                c = pattern[++i];
+            }
+
+            segment.text.push_back(any ? '\0' : c);
+            segment.any.push_back(any);
+            segment.has_any |= any;
+        }
+    }
+
+    bool operator()(std::string_view row) const {
+        const Segment& first = segments.front();
+        const Segment& last  = segments.back();
+
+        if (segments.size() == 1) {
+            return row.size() == first.text.size() && matches_at(first, row, 0);
+        }
+
+        if (row.size() < first.text.size() + last.text.size()
+            || !matches_at(first, row, 0)
+            || !matches_at(last, row, row.size() - last.text.size())) {
+            return false;
+        }
+
+        // the leftmost occurrence of each middle segment leaves the most room for the next ones
+        size_t pos = first.text.size();
+        const size_t end = row.size() - last.text.size();
+        for (size_t i=1; i + 1 < segments.size(); i++) {
+            pos = find(segments[i], row.substr(0, end), pos);
+            if (pos == std::string_view::npos) {
+                return false;
+            }
+
+            pos += segments[i].text.size();
+        }
+
+        return true;
+    }
+
+    // Literal runs of the pattern, each matching row contains all of them.
+    std::vector<std::string> literals() const {
+        std::vector<std::string> result;
+        for (const auto& segment: segments) {
+            std::string run;
+            for (size_t i=0; i <= segment.text.size(); i++) {
+                if (i == segment.text.size() || segment.any[i]) {
+                    if (!run.empty()) {
+                        result.push_back(std::move(run));
+                        run.clear();
+                    }
+                } else {
+                    run.push_back(segment.text[i]);
+                }
+            }
+        }
+
+        return result;
+    }
+
+private:
+    static bool matches_at(const Segment& segment, std::string_view row, size_t pos) {
+        if (!segment.has_any) {
+            return row.compare(pos, segment.text.size(), segment.text) == 0;
+        }
+
+        for (size_t i=0; i < segment.text.size(); i++) {
+            if (!segment.any[i] && row[pos + i] != segment.text[i]) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    static size_t find(const Segment& segment, std::string_view row, size_t from) {
+        if (!segment.has_any) {
+            return row.find(segment.text, from);
+        }
+
+        for (size_t pos=from; pos + segment.text.size() <= row.size(); pos++) {
+            if (matches_at(segment, row, pos)) {
+                return pos;
+            }
+        }
+
+        return std::string_view::npos;
+    }
+};
+
+
+// Derives a query implied by an ECMAScript regular expression, in the
+// spirit of Google Code Search. For each subexpression either the set of
+// all strings it matches is known (while the set is small), or a query
+// that the strings have to match. Sets are concatenated and joined
+// exactly; when a set gets too large, it's turned into an alternative
+// of terms. Constructs that are not understood match anything, thus the
+// result is always a necessary condition. The pattern must be valid.
+class regex_analyzer {
+
+    static constexpr size_t max_exact = 16;
+
+    using string_set = std::set<std::string>;
+
+    struct Info {
+        std::optional<string_set> exact;    // all strings matched, if known
+        Query match = Query::all_of({});    // otherwise, the required query
+    };
+
+    // thrown for syntax which might not be parsed correctly
+    struct unsupported {};
+
+    std::string_view re;
+    size_t pos = 0;
+
+    regex_analyzer(std::string_view re_)
+        : re(re_) {}
+
+public:
+    static Query required(std::string_view pattern) {
+        try {
+            regex_analyzer analyzer(pattern);
+            const Info info = analyzer.alternation();
+            if (analyzer.pos != pattern.size()) {
+                return Query::all_of({});
+            }
+
+            return condition(info);
+        } catch (const unsupported&) {
+            return Query::all_of({});
+        }
+    }
+
+private:
+    // The query that strings matched by a subexpression have to match.
+    static Query condition(const Info& info) {
+        if (!info.exact.has_value()) {
+            return info.match;
+        }
+
+        std::vector<Query> terms;
+        for (const auto& s: info.exact.value()) {
+            if (s.empty()) {
+                return Query::all_of({});
+            }
+
+            terms.push_back(Query::term(s));
+        }
+
+        return Query::any_of(std::move(terms));
+    }
+
+    static Info exact(string_set strings) {
+        Info info;
+        info.exact = std::move(strings);
+        return info;
+    }
+
+    static Info any() {
+        return Info();
+    }
+
+    static std::optional<string_set> product(const string_set& a, const string_set& b) {
+        if (a.size() * b.size() > max_exact) {
+            return std::nullopt;
+        }
+
+        string_set strings;
+        for (const auto& x: a) {
+            for (const auto& y: b) {
+                strings.insert(x + y);
+            }
+        }
+
+        return strings;
+    }
+
+    static Info alternate(const Info& a, const Info& b) {
+        if (a.exact.has_value() && b.exact.has_value() && a.exact->size() + b.exact->size() <= max_exact) {
+            string_set strings = a.exact.value();
+            strings.insert(b.exact->begin(), b.exact->end());
+
+            return exact(std::move(strings));
+        }
+
+        Info info;
+        info.match = condition(a) || condition(b);
+        return info;
+    }
+
+    bool done() const {
+        return pos >= re.size();
+    }
+
+    char peek() const {
+        return done() ? '\0' : re[pos];
+    }
+
+    char next() {
+        if (done()) {
+            throw unsupported();
+        }
+
+        return re[pos++];
+    }
+
+    void expect(char c) {
+        if (next() != c) {
+            throw unsupported();
+        }
+    }
+
+    Info alternation() {
+        Info info = concatenation();
+        while (!done() && peek() == '|') {
+            pos += 1;
+            info = alternate(info, concatenation());
+        }
+
+        return info;
+    }
+
+    // Strings of consecutive exact subexpressions are joined into runs,
+    // thus literals are not split by other subexpressions: "abc.*def"
+    // requires "abc" and "def".
+    Info concatenation() {
+        bool known = true;
+        string_set run = {""};
+        Query match = Query::all_of({});
+
+        while (!done() && peek() != '|' && peek() != ')') {
+            const Info info = repetition();
+            if (!info.exact.has_value()) {
+                match = std::move(match) && condition(exact(std::move(run))) && info.match;
+                run = {""};
+                known = false;
+            } else if (auto joined = product(run, info.exact.value())) {
+                run = std::move(joined.value());
+            } else {
+                match = std::move(match) && condition(exact(std::move(run)));
+                run = info.exact.value();
+                known = false;
+            }
+        }
+
+        if (known) {
+            return exact(std::move(run));
+        }
+
+        Info info;
+        info.match = std::move(match) && condition(exact(std::move(run)));
+        return info;
+    }
+
+    Info repetition() {
+        Info info = atom();
+        while (!done()) {
+            const char c = peek();
+            size_t min = 0;
+            if (c == '*' || c == '?') {
+                pos += 1;
+            } else if (c == '+') {
+                pos += 1;
+                min = 1;
+            } else if (c == '{') {
+                pos += 1;
+                min = number();
+                if (peek() == ',') {
+                    pos += 1;
+                    if (peek() != '}') {
+                        number();
+                    }
+                }
+                expect('}');
+            } else {
+                break;
+            }
+
+            if (!done() && peek() == '?') {
+                pos += 1; // lazy
+            }
+
+            if (min == 0) {
+                if (info.exact.has_value() && c == '?') {
+                    info.exact->insert("");
+                } else {
+                    info = any();
+                }
+            } else {
+                Info repeated;
+                repeated.match = condition(info);
+                info = std::move(repeated);
+            }
+        }
+
+        return info;
+    }
+
+    size_t number() {
+        if (done() || !isdigit(uint8_t(peek()))) {
+            throw unsupported();
+        }
+
+        size_t n = 0;
+        while (!done() && isdigit(uint8_t(peek()))) {
+            n = 10 * n + (next() - '0');
+        }
+
+        return n;
+    }
+
+    Info atom() {
+        const char c = next();
+        switch (c) {
+            case '(':
+                return group();
+
+            case '[':
+                return bracket();
+
+            case '\\':
+                return escape();
+
+            case '.':
+                return any();
+
+            case '^':
+            case '$':
+                return exact({""});
+
+            case '*': case '+': case '?': case '{': case '|': case ')':
+                throw unsupported();
+
+            default:
+                return exact({std::string(1, c)});
+        }
+    }
+
+    Info group() {
+        bool lookahead = false;
+        if (!done() && peek() == '?') {
+            pos += 1;
+            const char c = next();
+            if (c == '=' || c == '!') {
+                lookahead = true;
+            } else if (c != ':') {
+                throw unsupported();
+            }
+        }
+
+        Info info = alternation();
+        expect(')');
+
+        if (lookahead) {
+            return exact({""});
+        }
+
+        return info;
+    }
+
+    // Escapes outside of brackets; returns a single character or a class.
+    Info escape() {
+        std::optional<char> c = escaped_char();
+        if (!c.has_value()) {
+            return any();
+        }
+
+        return exact({std::string(1, c.value())});
+    }
+
+    // Returns std::nullopt for a class, an assertion or a back-reference;
+    // they are treated as matching anything.
+    std::optional<char> escaped_char() {
+        const char c = next();
+        switch (c) {
+            case 'd': case 'D': case 'w': case 'W': case 's': case 'S':
+            case 'b': case 'B':
+                return std::nullopt;
+
+            case 'n': return '\n';
+            case 'r': return '\r';
+            case 't': return '\t';
+            case 'f': return '\f';
+            case 'v': return '\v';
+            case '0': return '\0';
+
+            case 'x':
+                pos += 2;
+                return std::nullopt;
+
+            case 'u':
+                pos += 4;
+                return std::nullopt;
+
+            case 'c':
+                pos += 1;
+                return std::nullopt;
+
+            default:
+                if (isdigit(uint8_t(c))) {
+                    // a back-reference
+                    while (!done() && isdigit(uint8_t(peek()))) {
+                        pos += 1;
+                    }
+
+                    return std::nullopt;
+                }
+
+                if (isalpha(uint8_t(c))) {
+                    throw unsupported();
+                }
+
+                return c;
+        }
+    }
+
+    Info bracket() {
+        bool known = true;
+        if (!done() && peek() == '^') {
+            pos += 1;
+            known = false;
+        }
+
+        if (!done() && peek() == ']') {
+            throw unsupported();
+        }
+
+        string_set chars;
+        while (true) {
+            const std::optional<char> first = bracket_char();
+            if (!first.has_value()) {
+                known = false;
+            }
+
+            if (!done() && peek() == '-' && pos + 1 < re.size() && re[pos + 1] != ']') {
+                pos += 1;
+                const std::optional<char> last = bracket_char();
+                if (!first.has_value() || !last.has_value() || uint8_t(last.value()) - uint8_t(first.value()) >= int(max_exact)) {
+                    known = false;
+                } else {
+                    for (int k=uint8_t(first.value()); k <= uint8_t(last.value()); k++) {
+                        chars.insert(std::string(1, char(k)));
+                    }
+                }
+            } else if (first.has_value()) {
+                chars.insert(std::string(1, first.value()));
+            }
+
+            if (!done() && peek() == ']') {
+                pos += 1;
+                break;
+            }
+        }
+
+        if (!known || chars.size() > max_exact) {
+            return any();
+        }
+
+        return exact(std::move(chars));
+    }
+
+    std::optional<char> bracket_char() {
+        const char c = next();
+        if (c == '[') {
+            // [:alpha:] and alike
+            throw unsupported();
+        }
+
+        if (c != '\\') {
+            return c;
+        }
+
+        if (!done() && peek() == 'b') {
+            pos += 1;
+            return '\b';
+        }
+
+        return escaped_char();
+    }
+};
+
+
+// Rows matching a SQL LIKE pattern, see like_matcher.
+inline Query like_query(std::string_view pattern) {
+    const auto matcher = std::make_shared<const like_matcher>(pattern);
+
+    std::vector<Query> terms;
+    for (const auto& literal: matcher->literals()) {
+        terms.push_back(Query::term(literal));
+    }
+
+    return Query::predicate([matcher](std::string_view row) {
+        return (*matcher)(row);
+    }, Query::all_of(std::move(terms)));
+}
+
+
+// Rows containing a match of an ECMAScript regular expression, see
+// regex_analyzer. Throws std::regex_error if the pattern is invalid.
+inline Query regex_query(std::string_view pattern) {
+    const auto re = std::make_shared<const std::regex>(pattern.begin(), pattern.end(), std::regex::ECMAScript | std::regex::optimize);
+
+    return Query::predicate([re](std::string_view row) {
+        return std::regex_search(row.begin(), row.end(), *re);
+    }, regex_analyzer::required(pattern));
+}
+
+
+// Rows containing a substring within edit distance k of word. An edit
+// destroys at most 3 trigrams of word, thus such a row contains at least
+// T = distinct - 3k of word's distinct trigrams; rows having T of them
+// (see TOccurrence) are verified with approximate_matcher.
+// When T is not positive, all rows are verified.
+inline Query fuzzy_query(std::string_view word, size_t k) {
+    std::set<std::string> trigrams;
+    for (size_t i=0; i + 2 < word.size(); i++) {
+        trigrams.emplace(word.substr(i, 3));
+    }
+
+    Query required = Query::all_of({});
+    if (trigrams.size() > 3 * k) {
+        std::vector<Query> terms;
+        for (const auto& trigram: trigrams) {
+            terms.push_back(Query::term(trigram));
+        }
+
+        required = Query::at_least(trigrams.size() - 3 * k, std::move(terms));
+    }
+
+    const auto matcher = std::make_shared<const approximate_matcher>(word, k);
+
+    return Query::predicate([matcher](std::string_view row) {
+        return (*matcher)(row);
+    }, std::move(required));
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "IndexedDB.h"
+#include "PositionalIndex.h"
+
+// IndexedDB with a positional index, which answers queries of 4 up to
+// `max_length` characters exactly: adjacency of trigrams is checked
+// while intersecting, no candidate row is verified. Longer queries use
+// the trigram index, as the cost of intersecting positions grows with
+// the number of trigrams and long queries have few false positives.
+template <typename COMBINER>
+class PositionalDB: public IndexedDB<COMBINER> {
+
+    using base = IndexedDB<COMBINER>;
+
+public:
+    using bitvector_type = typename base::bitvector_type;
+    using index_type = typename base::index_type;
+
+    static constexpr size_t default_max_length = 8;
+
+private:
+    const PositionalIndex positional;
+    const size_t max_length;
+
+public:
+    PositionalDB(const Collection& rows_, index_type&& index_, size_t max_length_ = default_max_length)
+        : base(rows_, std::move(index_))
+        , positional(rows_)
+        , max_length(max_length_) {}
+
+public:
+    virtual int matches(std::string_view word) const override {
+        if (use_positional(word)) {
+            return positional.count(word);
+        }
+
+        return base::matches(word);
+    }
+
+    virtual size_t visit_matches(std::string_view word, size_t limit, const DB::row_visitor& visitor) const override {
+        if (use_positional(word)) {
+            return positional.visit(word, limit, visitor);
+        }
+
+        return base::visit_matches(word, limit, visitor);
+    }
+
+    // IndexedDB::matches_batch would verify all queries.
+    virtual void matches_batch(const std::string_view* words, size_t n, int* results) const override {
+        DB::matches_batch(words, n, results);
+    }
+
+    const PositionalIndex& get_positional_index() const {
+        return positional;
+    }
+
+private:
+    bool use_positional(std::string_view word) const {
+        return word.size() > 3 && word.size() <= max_length;
+    }
+};
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "Index.h"
+#include "container_facade.h"
+#include "vector_facade.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+// Trigram index that stores positions of trigrams rather than rows.
+//
+// Rows are laid out one after another with a one-character gap, like in
+// Collection; a posting is the offset of a trigram in this layout, thus
+// no trigram spans two rows. A word occurs at offset p if its i-th trigram
+// occurs at p + i for all i, which is checked by intersecting posting
+// lists shifted by i. The result is exact, no row has to be verified.
+//
+// Postings take 4 bytes per trigram occurrence, that is roughly 4 bytes
+// per character of the collection.
+class PositionalIndex {
+
+    using postings_type = vector_facade;
+    using index_type = Index<postings_type>;
+
+    index_type index;                   // "rows" of postings are offsets
+    std::vector<uint32_t> row_starts;   // offset of each row
+
+public:
+    template <typename COLLECTION>
+    PositionalIndex(const COLLECTION& rows) {
+        size_t total = 0;
+        row_starts.reserve(rows.size());
+        for (size_t row=0; row < rows.size(); row++) {
+            row_starts.push_back(total);
+            total += rows[row].size() + 1;
+            if (total > UINT32_MAX) {
+                throw std::length_error("PositionalIndex: too much data");
+            }
+        }
+
+        for (size_t row=0; row < rows.size(); row++) {
+            const std::string_view str = rows[row];
+            for (size_t i=0; i + 2 < str.size(); i++) {
+                const uint32_t trigram = index_type::trigram(str, i);
+                auto* item = index.find(trigram);
+                if (item == nullptr) {
+                    item = &index.insert(trigram, postings_type(total));
+                }
+
+                item->bv.set(row_starts[row] + i);
+            }
+        }
+
+        index.update_internal_structures();
+    }
+
+public:
+    // Calls visitor(row) for rows containing word (at least 3 characters),
+    // in ascending order, until the visitor returns false or `limit` rows
+    // were visited; returns the number of visited rows.
+    size_t visit(std::string_view word, size_t limit, const std::function<bool(size_t row)>& visitor) const {
+        return visit_rows(word, limit, visitor);
+    }
+
+    size_t count(std::string_view word) const {
+        return visit_rows(word, SIZE_MAX, [](size_t) {
+            return true;
+        });
+    }
+
+    size_t size_in_bytes() const {
+        size_t total = 0;
+
+        total += sizeof(*this);
+        total += index.size_in_bytes();
+        total += row_starts.capacity() * sizeof(uint32_t);
+
+        return total;
+    }
+
+private:
+    template <typename VISITOR>
+    size_t visit_rows(std::string_view word, size_t limit, VISITOR visitor) const {
+        assert(word.size() >= 3);
+
+        size_t count = 0;
+        if (limit == 0) {
+            return count;
+        }
+
+        // a row might contain word several times
+        size_t row = 0;
+        bool visited = false;
+        for (const uint32_t offset: occurrences(word)) {
+            const size_t r = row_of(offset, row);
+            if (visited && r == row) {
+                continue;
+            }
+
+            row = r;
+            visited = true;
+            count += 1;
+            if (!visitor(row) || count == limit) {
+                break;
+            }
+        }
+
+        return count;
+    }
+
+    // Row containing offset; rows before `first` are skipped. Matches
+    // are usually close, thus exponential search.
+    size_t row_of(uint32_t offset, size_t first) const {
+        const size_t n = row_starts.size();
+
+        size_t bound = 1;
+        while (first + bound < n && row_starts[first + bound] <= offset) {
+            bound *= 2;
+        }
+
+        const auto begin = row_starts.begin();
+        return std::upper_bound(begin + first + bound / 2, begin + std::min(first + bound, n), offset) - begin - 1;
+    }
+
+public:
+    // Offsets where word begins, ascending.
+    std::vector<uint32_t> occurrences(std::string_view word) const {
+        static const intersect_inplace_fn block = intersect_inplace_block();
+
+        assert(word.size() >= 3);
+
+        // (postings of i-th trigram, i)
+        std::vector<std::pair<index_range, uint32_t>> lists;
+        for (size_t i=0; i + 2 < word.size(); i++) {
+            const auto* item = index.find(index_type::trigram(word, i));
+            if (item == nullptr) {
+                return {};
+            }
+
+            lists.emplace_back(item->bv.range(), i);
+        }
+
+        std::sort(lists.begin(), lists.end(), [](const auto& a, const auto& b) {
+            return a.first.size() < b.first.size();
+        });
+
+        // the shortest list gives candidate offsets of word
+        std::vector<uint32_t> result;
+        result.reserve(lists[0].first.size());
+        for (const uint32_t offset: lists[0].first) {
+            if (offset >= lists[0].second) {
+                result.push_back(offset - lists[0].second);
+            }
+        }
+
+        size_t n = result.size();
+        for (size_t k=1; k < lists.size() && n > 0; k++) {
+            const auto& [list, shift] = lists[k];
+            for (size_t j=0; j < n; j++) {
+                result[j] += shift;
+            }
+
+            if (list.size() / 32 > n) {
+                n = intersect_inplace_galloping(result.data(), n, list);
+            } else {
+                n = block(result.data(), n, list);
+            }
+
+            for (size_t j=0; j < n; j++) {
+                result[j] -= shift;
+            }
+        }
+
+        result.resize(n);
+        return result;
+    }
+};
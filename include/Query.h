@@ -0,0 +1,177 @@
+#pragma once
+
+#include "substring.h"
+
+#include <cassert>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Boolean expression over substrings. A term matches rows containing
+// its text; all_of, any_of and negation combine subexpressions.
+//
+//    auto q = Query::term("london") && !(Query::term("derry") || Query::term("ontario"));
+//
+// all_of({}) matches every row, any_of({}) none. A predicate matches rows
+// accepted by an arbitrary function, see Pattern.h.
+class Query {
+public:
+    enum class kind {
+        term,
+        all_of,
+        any_of,
+        negation,   // has exactly one child
+        predicate,  // has exactly one child, the required query
+        at_least,   // matches if at least `threshold` children match
+    };
+
+    using predicate_type = std::function<bool(std::string_view row)>;
+
+private:
+    kind m_kind;
+    std::string m_text;
+    std::vector<Query> m_children;
+    predicate_type m_predicate;
+    size_t m_threshold = 0;
+
+    Query(kind k, std::string_view text, std::vector<Query>&& children, predicate_type&& predicate = nullptr)
+        : m_kind(k)
+        , m_text(text)
+        , m_children(std::move(children))
+        , m_predicate(std::move(predicate)) {}
+
+public:
+    static Query term(std::string_view text) {
+        return Query(kind::term, text, {});
+    }
+
+    static Query all_of(std::vector<Query> children) {
+        return Query(kind::all_of, {}, std::move(children));
+    }
+
+    static Query any_of(std::vector<Query> children) {
+        return Query(kind::any_of, {}, std::move(children));
+    }
+
+    static Query negation(Query query) {
+        std::vector<Query> children;
+        children.push_back(std::move(query));
+        return Query(kind::negation, {}, std::move(children));
+    }
+
+    // `required` has to match every row accepted by the predicate; it's
+    // used only to find candidates, which are then checked by the predicate.
+    static Query predicate(predicate_type predicate, Query required = all_of({})) {
+        assert(predicate != nullptr);
+
+        std::vector<Query> children;
+        children.push_back(std::move(required));
+        return Query(kind::predicate, {}, std::move(children), std::move(predicate));
+    }
+
+    // at_least(1, ...) is an alternative, at_least(children.size(), ...)
+    // a conjunction; see also fuzzy_query.
+    static Query at_least(size_t threshold, std::vector<Query> children) {
+        Query query(kind::at_least, {}, std::move(children));
+        query.m_threshold = threshold;
+        return query;
+    }
+
+    // Nested conjunctions and alternatives are flattened.
+    friend Query operator&&(Query a, Query b) {
+        return join(kind::all_of, std::move(a), std::move(b));
+    }
+
+    friend Query operator||(Query a, Query b) {
+        return join(kind::any_of, std::move(a), std::move(b));
+    }
+
+    friend Query operator!(Query a) {
+        if (a.m_kind == kind::negation) {
+            return std::move(a.m_children[0]);
+        }
+
+        return negation(std::move(a));
+    }
+
+public:
+    kind get_kind() const {
+        return m_kind;
+    }
+
+    // Only for terms
+    std::string_view text() const {
+        assert(m_kind == kind::term);
+        return m_text;
+    }
+
+    const std::vector<Query>& children() const {
+        return m_children;
+    }
+
+    // Only for at_least
+    size_t threshold() const {
+        assert(m_kind == kind::at_least);
+        return m_threshold;
+    }
+
+    bool matches(std::string_view row) const {
+        switch (m_kind) {
+            case kind::term:
+                return substring_contains(row, m_text);
+
+            case kind::all_of:
+                for (const auto& child: m_children) {
+                    if (!child.matches(row)) {
+                        return false;
+                    }
+                }
+
+                return true;
+
+            case kind::any_of:
+                for (const auto& child: m_children) {
+                    if (child.matches(row)) {
+                        return true;
+                    }
+                }
+
+                return false;
+
+            case kind::negation:
+                return !m_children[0].matches(row);
+
+            case kind::predicate:
+                return m_predicate(row);
+
+            case kind::at_least: {
+                size_t count = 0;
+                for (size_t i=0; i < m_children.size() && count < m_threshold; i++) {
+                    count += m_children[i].matches(row);
+                }
+
+                return count >= m_threshold;
+            }
+        }
+
+        return false;
+    }
+
+private:
+    static Query join(kind k, Query a, Query b) {
+        std::vector<Query> children;
+        for (Query* q: {&a, &b}) {
+            if (q->m_kind == k) {
+                for (auto& child: q->m_children) {
+                    children.push_back(std::move(child));
+                }
+            } else {
+                children.push_back(std::move(*q));
+            }
+        }
+
+        return Query(k, {}, std::move(children));
+    }
+};
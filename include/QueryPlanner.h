@@ -0,0 +1,261 @@
+#pragma once
+
+#include "Index.h"
+#include "Query.h"
+#include "combiner/TOccurrence.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Plans a boolean query over postings of an index. Terms of a conjunction
+// are combined at once, thus the combiner sees keys of all of them;
+// alternatives are unions. A negation gives no candidates, it is left to
+// the verification; a predicate gives candidates of its required query.
+// Candidates of at_least are found by TOccurrence.
+//
+// A result is either a posting list of the index or a bitvector owned by
+// the planner, thus it is valid as long as both of them.
+template <typename COMBINER>
+class QueryPlanner {
+public:
+    using bitvector_type = typename COMBINER::bitvector_type;
+    using index_type = Index<bitvector_type>;
+
+private:
+    using Item = typename index_type::Item;
+
+    const index_type& index;
+
+    // combiners keep their results, thus they are not copied
+    std::deque<COMBINER> combiners;
+    std::deque<TOccurrence<bitvector_type>> occurrences;
+    std::deque<bitvector_type> owned;   // results of unions and intersections
+
+public:
+    QueryPlanner(const index_type& index_)
+        : index(index_) {}
+
+    QueryPlanner(const QueryPlanner&) = delete;
+    QueryPlanner& operator=(const QueryPlanner&) = delete;
+
+    // Sets `result` to a superset of rows matching query, nullptr if there
+    // are none. Returns false if the index does not narrow the query, then
+    // all rows are candidates.
+    bool candidates(const Query& query, const bitvector_type*& result) {
+        switch (query.get_kind()) {
+            case Query::kind::term:
+                return candidates_all_of(&query, 1, result);
+
+            case Query::kind::all_of:
+                return candidates_all_of(query.children().data(), query.children().size(), result);
+
+            case Query::kind::any_of:
+                result = nullptr;
+                for (const auto& child: query.children()) {
+                    const bitvector_type* bv = nullptr;
+                    if (!candidates(child, bv)) {
+                        return false;
+                    }
+
+                    if (bv == nullptr) {
+                        continue;
+                    }
+
+                    if (result == nullptr) {
+                        result = bv;
+                    } else {
+                        unite(result, *bv);
+                    }
+                }
+
+                return true;
+
+            case Query::kind::negation:
+                return false;
+
+            case Query::kind::predicate:
+                return candidates(query.children()[0], result);
+
+            case Query::kind::at_least:
+                return candidates_at_least(query, result);
+        }
+
+        return false;
+    }
+
+private:
+    // Returns bv if the planner owns it, nullptr otherwise.
+    bitvector_type* find_owned(const bitvector_type* bv) {
+        for (auto& item: owned) {
+            if (&item == bv) {
+                return &item;
+            }
+        }
+
+        return nullptr;
+    }
+
+    // result |= bv; a posting list or a combiner's result is copied.
+    void unite(const bitvector_type*& result, const bitvector_type& bv) {
+        bitvector_type* sum = find_owned(result);
+        if (sum == nullptr) {
+            sum = &owned.emplace_back(*result);
+        }
+
+        bitvector_type::bit_or_inplace(*sum, bv);
+        result = sum;
+    }
+
+    // result &= bv, in place if the planner owns the result; returns false
+    // if it's known to be empty.
+    bool intersect(const bitvector_type*& result, const bitvector_type& bv) {
+        if (bitvector_type* product = find_owned(result)) {
+            return bitvector_type::bit_and_inplace(*product, bv);
+        }
+
+        auto product = bitvector_type::bit_and(*result, bv);
+        if (!product.has_value()) {
+            return false;
+        }
+
+        result = &owned.emplace_back(std::move(product.value()));
+        return true;
+    }
+
+    // See candidates(). Postings of 3-character terms are used directly.
+    // A child that cannot be narrowed might match any row, thus it lowers
+    // the threshold.
+    bool candidates_at_least(const Query& query, const bitvector_type*& result) {
+        result = nullptr;
+
+        size_t threshold = query.threshold();
+        std::vector<const Item*> postings;
+        std::vector<const bitvector_type*> others;  // candidates of other children
+        for (const auto& child: query.children()) {
+            if (threshold == 0) {
+                return false;
+            }
+
+            if (child.get_kind() == Query::kind::term && child.text().size() == 3) {
+                if (const Item* item = index.find(index_type::trigram(child.text(), 0))) {
+                    postings.push_back(item);
+                }
+
+                continue;
+            }
+
+            const bitvector_type* bv = nullptr;
+            if (!candidates(child, bv)) {
+                threshold -= 1;
+            } else if (bv != nullptr) {
+                others.push_back(bv);
+            }
+        }
+
+        if (threshold == 0) {
+            return false;
+        }
+
+        auto& combiner = occurrences.emplace_back(threshold);
+        for (const Item* item: postings) {
+            combiner.add(item->bv, item->get_cardinality());
+        }
+
+        for (const bitvector_type* bv: others) {
+            combiner.add(*bv, bv->cardinality());
+        }
+
+        if (combiner.finish()) {
+            result = &combiner.value();
+        }
+
+        return true;
+    }
+
+    // See candidates(); queries are conjuncts. Repeated keys are combined
+    // once, postings go to the combiner from the shortest one.
+    bool candidates_all_of(const Query* queries, size_t n, const bitvector_type*& result) {
+        result = nullptr;
+
+        std::vector<uint32_t> keys;
+        for (size_t i=0; i < n; i++) {
+            if (queries[i].get_kind() != Query::kind::term) {
+                continue;
+            }
+
+            const std::string_view text = queries[i].text();
+            if (text.size() >= 3) {
+                index.visit_query_keys(text, [&keys](uint32_t key) {
+                    keys.push_back(key);
+                });
+            } else if (!text.empty() && index.short_postings) {
+                keys.push_back(index_type::short_key(text));
+            }
+        }
+
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+        std::vector<const Item*> postings;
+        for (const uint32_t key: keys) {
+            const Item* item = index.find(key);
+            if (item == nullptr) {
+                // a term does not occur
+                return true;
+            }
+
+            postings.push_back(item);
+        }
+
+        std::stable_sort(postings.begin(), postings.end(), [](const Item* a, const Item* b) {
+            return a->get_cardinality() < b->get_cardinality();
+        });
+
+        if (postings.size() == 1) {
+            result = &postings[0]->bv;
+        } else if (postings.size() > 1) {
+            auto& combiner = combiners.emplace_back();
+            for (const Item* item: postings) {
+                if (!combiner.add(item->bv, item->get_cardinality()))
+                    break;
+            }
+
+            if (!combiner.finish()) {
+                return true;
+            }
+
+            result = &combiner.value();
+        }
+
+        bool narrowed = !postings.empty();
+        for (size_t i=0; i < n; i++) {
+            if (queries[i].get_kind() == Query::kind::term) {
+                continue;
+            }
+
+            const bitvector_type* bv = nullptr;
+            if (!candidates(queries[i], bv)) {
+                continue;
+            }
+
+            if (bv == nullptr) {
+                result = nullptr;
+                return true;
+            }
+
+            if (!narrowed) {
+                result = bv;
+                narrowed = true;
+            } else if (!intersect(result, *bv)) {
+                result = nullptr;
+                return true;
+            }
+        }
+
+        return narrowed;
+    }
+};
@@ -0,0 +1,262 @@
+#pragma once
+
+#include "NaiveDB.h"
+#include "Builder.h"
+#include "QueryPlanner.h"
+#include "ThreadPool.h"
+
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+// Rows are split into segments of a fixed size, each segment has own
+// index. Row ids stored in bitvectors are relative to the segment, thus
+// for segments of up to 64K rows 16-bit postings suffice (vector16_facade).
+// Segments are built and searched in parallel, a query result is the sum
+// of matches from all segments.
+template <typename COMBINER>
+class ShardedDB: public NaiveDB {
+public:
+    using bitvector_type = typename COMBINER::bitvector_type;
+    using index_type = Index<bitvector_type>;
+
+    static constexpr size_t default_segment_size = 1 << 16;
+
+private:
+    struct Segment {
+        size_t first;   // the first row
+        size_t size;    // the number of rows
+        index_type index;
+    };
+
+    // Rows of a segment, as seen by Builder
+    class segment_rows {
+        const Collection& rows;
+        const Segment& segment;
+
+    public:
+        segment_rows(const Collection& rows_, const Segment& segment_)
+            : rows(rows_)
+            , segment(segment_) {}
+
+        size_t size() const {
+            return segment.size;
+        }
+
+        std::string_view operator[](size_t index) const {
+            return rows[segment.first + index];
+        }
+    };
+
+    std::vector<Segment> segments;
+    ThreadPool& pool;
+
+public:
+    // The pool must outlive the database.
+    ShardedDB(const Collection& rows_, ThreadPool& pool_, size_t segment_size = default_segment_size)
+        : NaiveDB(rows_)
+        , pool(pool_) {
+
+        if (segment_size == 0) {
+            throw std::invalid_argument("ShardedDB: segment size must be greater than zero");
+        }
+
+        // ids of rows in a segment start from zero
+        if (segment_size - 1 > bitvector_type::max_index) {
+            throw std::invalid_argument("ShardedDB: segment size exceeds the range of the bitvector type");
+        }
+
+        for (size_t first=0; first < rows.size(); first += segment_size) {
+            segments.push_back({first, std::min(segment_size, rows.size() - first), {}});
+        }
+
+        pool.for_each_range(segments.size(), 1, [this](size_t first, size_t last) {
+            for (size_t i=first; i < last; i++) {
+                Segment& segment = segments[i];
+
+                Builder<bitvector_type> builder(segment.size);
+                builder.add(segment_rows(rows, segment));
+                segment.index = builder.capture();
+            }
+        });
+    }
+
+public:
+    virtual int matches(std::string_view word) const override {
+
+        if (word.size() == 3) {
+            // just a sum of cardinalities, not worth splitting
+            size_t count = 0;
+            for (const auto& segment: segments) {
+                count += matches_len3(segment, word);
+            }
+
+            return count;
+        }
+
+        if (segments.size() == 1) {
+            return matches(segments[0], word);
+        }
+
+        std::vector<size_t> counts(segments.size());
+        pool.for_each_range(segments.size(), 1, [this, &counts, word](size_t first, size_t last) {
+            for (size_t i=first; i < last; i++) {
+                counts[i] = matches(segments[i], word);
+            }
+        });
+
+        size_t count = 0;
+        for (const size_t c: counts) {
+            count += c;
+        }
+
+        return count;
+    }
+
+    // Segments are visited one by one, thus a limited query stops
+    // at the first segments. See IndexedDB::visit_matches.
+    virtual size_t visit_matches(std::string_view word, size_t limit, const row_visitor& visitor) const override {
+        size_t count = 0;
+        bool stop = (limit == 0);
+        for (size_t i=0; i < segments.size() && !stop; i++) {
+            const size_t remaining = (limit == unlimited) ? unlimited : limit - count;
+            count += visit_matches(segments[i], word, remaining, [&visitor, &stop](size_t row) {
+                stop = !visitor(row);
+                return !stop;
+            });
+
+            stop |= (count == limit);
+        }
+
+        return count;
+    }
+
+    // Each segment has own plan, see IndexedDB::visit_query.
+    virtual size_t visit_query(const Query& query, size_t limit, const row_visitor& visitor) const override {
+        size_t count = 0;
+        bool stop = (limit == 0);
+        for (size_t i=0; i < segments.size() && !stop; i++) {
+            const Segment& segment = segments[i];
+
+            auto verify = [this, &segment, &query, &limit, &visitor, &count, &stop](const uint32_t* ids, size_t n) {
+                for (size_t j=0; j < n && !stop; j++) {
+                    const size_t row = segment.first + ids[j];
+                    if (query.matches(rows[row])) {
+                        count += 1;
+                        stop = !visitor(row) || count == limit;
+                    }
+                }
+
+                return !stop;
+            };
+
+            QueryPlanner<COMBINER> planner(segment.index);
+            const bitvector_type* candidates = nullptr;
+            if (!planner.candidates(query, candidates)) {
+                for (uint32_t j=0; j < segment.size && !stop; j++) {
+                    verify(&j, 1);
+                }
+            } else if (candidates != nullptr) {
+                candidates->visit_batches_until(verify);
+            }
+        }
+
+        return count;
+    }
+
+    size_t segments_count() const {
+        return segments.size();
+    }
+
+    size_t size_in_bytes() const {
+        size_t total = 0;
+
+        total += sizeof(*this);
+        total += segments.capacity() * sizeof(Segment);
+        for (const auto& segment: segments) {
+            total += segment.index.size_in_bytes();
+        }
+
+        return total;
+    }
+
+private:
+    size_t matches(const Segment& segment, std::string_view word) const {
+
+        if (word.size() < 3) {
+            size_t count = 0;
+            for (size_t i=0; i < segment.size; i++) {
+                count += substring_contains(rows[segment.first + i], word);
+            }
+
+            return count;
+        }
+
+        if (word.size() == 3) {
+            return matches_len3(segment, word);
+        }
+
+        COMBINER combiner;
+        if (!segment.index.combine(word, combiner)) {
+            return 0;
+        }
+
+        size_t count = 0;
+        combiner.value().visit_batches([this, &segment, &word, &count](const uint32_t* ids, size_t n) {
+            for (size_t i=0; i < n; i++) {
+                count += substring_contains(rows[segment.first + ids[i]], word);
+            }
+        });
+
+        return count;
+    }
+
+    size_t visit_matches(const Segment& segment, std::string_view word, size_t limit, const row_visitor& visitor) const {
+
+        size_t count = 0;
+        bool stop = false;
+        auto verify = [this, &segment, &word, &limit, &visitor, &count, &stop](const uint32_t* ids, size_t n) {
+            for (size_t i=0; i < n && !stop; i++) {
+                const size_t row = segment.first + ids[i];
+                if (substring_contains(rows[row], word)) {
+                    count += 1;
+                    stop = !visitor(row) || count == limit;
+                }
+            }
+
+            return !stop;
+        };
+
+        if (word.size() < 3) {
+            for (uint32_t i=0; i < segment.size && !stop; i++) {
+                verify(&i, 1);
+            }
+        } else {
+            const auto* item = (word.size() == 3 || limit != unlimited) ? segment.index.cheapest(word) : nullptr;
+            if (item != nullptr && (word.size() == 3 || item->get_cardinality() <= index_type::verify_cheapest_limit)) {
+                item->bv.visit_batches_until(verify);
+            } else if (word.size() > 3) {
+                COMBINER combiner;
+                if (segment.index.combine(word, combiner)) {
+                    combiner.value().visit_batches_until(verify);
+                }
+            }
+        }
+
+        return count;
+    }
+
+    size_t matches_len3(const Segment& segment, std::string_view word) const {
+
+        if (has_null_character(word)) {
+            return 0;
+        }
+
+        const auto* item = segment.index.find(index_type::trigram(word, 0));
+        if (item == nullptr) {
+            return 0;
+        }
+
+        return item->get_cardinality();
+    }
+};
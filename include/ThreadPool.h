@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size thread pool with work stealing. Each worker has its own queue,
+// tasks are submitted to queues in round-robin order. A worker takes tasks
+// from the front of its queue; when the queue is empty, it steals from
+// the back of other queues, thus a few expensive tasks do not stall cheap
+// ones queued after them.
+class ThreadPool final {
+
+    using task_type = std::function<void()>;
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<task_type> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::condition_variable done;
+    std::atomic<size_t> available{0};   // tasks in queues
+    size_t pending = 0;                 // tasks not finished yet, guarded by mutex
+    size_t next_queue = 0;              // guarded by mutex
+    bool stop = false;                  // guarded by mutex
+
+public:
+    ThreadPool(size_t threads) {
+        threads = std::max(size_t(1), threads);
+        for (size_t i=0; i < threads; i++) {
+            queues.emplace_back(new Queue);
+        }
+
+        for (size_t i=0; i < threads; i++) {
+            workers.emplace_back([this, i] { run(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+
+        wakeup.notify_all();
+        for (auto& worker: workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const {
+        return workers.size();
+    }
+
+    void submit(task_type task) {
+        size_t queue;
+        {
+            // counted before the task is queued, so the counter never drops
+            // below zero; incremented under the mutex, so a waiting worker
+            // can't miss the wakeup
+            std::lock_guard<std::mutex> lock(mutex);
+            queue = next_queue;
+            next_queue = (next_queue + 1) % queues.size();
+            pending += 1;
+            available += 1;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+            queues[queue]->tasks.push_back(std::move(task));
+        }
+
+        wakeup.notify_one();
+    }
+
+    // Waits until all submitted tasks are finished.
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0; });
+    }
+
+    // Splits range [0, n) into parts of `grain` items, calls fun(first, last)
+    // for each part and waits for completion of these parts only. While
+    // waiting, the caller executes queued tasks, thus the function might
+    // be called concurrently and also from tasks of the same pool.
+    template <typename FUNCTION>
+    void for_each_range(size_t n, size_t grain, FUNCTION fun) {
+        struct {
+            std::mutex mutex;
+            std::condition_variable done;
+            size_t pending = 0;
+        } state;
+
+        grain = std::max(size_t(1), grain);
+        state.pending = (n + grain - 1) / grain;
+        for (size_t first=0; first < n; first += grain) {
+            const size_t last = std::min(n, first + grain);
+            submit([&fun, &state, first, last] {
+                fun(first, last);
+
+                // notified under the lock, the caller can't release `state` before
+                std::lock_guard<std::mutex> lock(state.mutex);
+                state.pending -= 1;
+                if (state.pending == 0) {
+                    state.done.notify_all();
+                }
+            });
+        }
+
+        while (true) {
+            task_type task;
+            if (steal(queues.size(), task)) {
+                task();
+                finished();
+                continue;
+            }
+
+            // the remaining parts are being executed by workers
+            std::unique_lock<std::mutex> lock(state.mutex);
+            state.done.wait(lock, [&state] { return state.pending == 0; });
+            return;
+        }
+    }
+
+private:
+    void run(size_t id) {
+        while (true) {
+            task_type task;
+            if (pop(id, task) || steal(id, task)) {
+                task();
+                finished();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeup.wait(lock, [this] { return stop || available > 0; });
+            if (stop && available == 0) {
+                return;
+            }
+        }
+    }
+
+    bool pop(size_t id, task_type& task) {
+        Queue& queue = *queues[id];
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            return false;
+        }
+
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        available -= 1;
+
+        return true;
+    }
+
+    // Takes a task from the back of any queue except the queue `id`.
+    bool steal(size_t id, task_type& task) {
+        for (size_t i=0; i < queues.size(); i++) {
+            const size_t q = (id + 1 + i) % queues.size();
+            if (q == id) {
+                continue;
+            }
+
+            Queue& queue = *queues[q];
+
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.tasks.empty()) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+                available -= 1;
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void finished() {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending -= 1;
+        if (pending == 0) {
+            done.notify_all();
+        }
+    }
+};
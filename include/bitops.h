@@ -0,0 +1,415 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__)
+#   include <immintrin.h>
+#endif
+
+// Kernels for arrays of 64-bit words used by dense bitvectors.
+//
+// * popcount(a, n)        - number of bits set in a[0 .. n - 1];
+// * and_count(c, a, b, n) - c[i] = a[i] & b[i], returns popcount of c;
+//                           c might be the same array as a.
+//
+// bitops_decoder converts set bits into row ids.
+//
+// Vectorized popcounts use the Harley-Seal algorithm: 16 vectors are reduced
+// with carry-save adders, so only one vector popcount is needed per 16 vectors.
+
+struct bitops_kernel {
+    const char* name;
+    size_t (*popcount)(const uint64_t* a, size_t n);
+    size_t (*and_count)(uint64_t* c, const uint64_t* a, const uint64_t* b, size_t n);
+};
+
+
+inline size_t bitops_popcount_scalar(const uint64_t* a, size_t n) {
+    size_t k = 0;
+    for (size_t i=0; i < n; i++) {
+        k += __builtin_popcountll(a[i]);
+    }
+
+    return k;
+}
+
+
+inline size_t bitops_and_count_scalar(uint64_t* c, const uint64_t* a, const uint64_t* b, size_t n) {
+    size_t k = 0;
+    for (size_t i=0; i < n; i++) {
+        c[i] = a[i] & b[i];
+        k += __builtin_popcountll(c[i]);
+    }
+
+    return k;
+}
+
+
+#if defined(__x86_64__)
+
+// --- AVX2 ----------------------------------------------------------------
+
+__attribute__((target("avx2")))
+inline void bitops_csa_avx2(__m256i& h, __m256i& l, __m256i a, __m256i b, __m256i c) {
+    const __m256i u = _mm256_xor_si256(a, b);
+    h = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(u, c));
+    l = _mm256_xor_si256(u, c);
+}
+
+
+// returns four 64-bit counters
+__attribute__((target("avx2")))
+inline __m256i bitops_popcount_avx2(__m256i v) {
+    const __m256i lookup = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+
+    const __m256i lo = _mm256_and_si256(v, low_mask);
+    const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    const __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                                        _mm256_shuffle_epi8(lookup, hi));
+
+    return _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+}
+
+
+struct bitops_load_avx2 {
+    const __m256i* a;
+
+    __attribute__((target("avx2")))
+    __m256i operator()(size_t i) const {
+        return _mm256_loadu_si256(a + i);
+    }
+};
+
+
+struct bitops_and_store_avx2 {
+    __m256i* c;
+    const __m256i* a;
+    const __m256i* b;
+
+    __attribute__((target("avx2")))
+    __m256i operator()(size_t i) const {
+        const __m256i v = _mm256_and_si256(_mm256_loadu_si256(a + i), _mm256_loadu_si256(b + i));
+        _mm256_storeu_si256(c + i, v);
+        return v;
+    }
+};
+
+
+// popcount of n vectors returned by load(0) .. load(n - 1)
+template <typename LOAD>
+__attribute__((target("avx2")))
+inline size_t bitops_harley_seal_avx2(size_t n, LOAD load) {
+    __m256i total    = _mm256_setzero_si256();
+    __m256i ones     = _mm256_setzero_si256();
+    __m256i twos     = _mm256_setzero_si256();
+    __m256i fours    = _mm256_setzero_si256();
+    __m256i eights   = _mm256_setzero_si256();
+    __m256i sixteens;
+    __m256i twosA, twosB, foursA, foursB, eightsA, eightsB;
+
+    size_t i = 0;
+    for (/**/; i + 16 <= n; i += 16) {
+        bitops_csa_avx2(twosA, ones, ones, load(i + 0), load(i + 1));
+        bitops_csa_avx2(twosB, ones, ones, load(i + 2), load(i + 3));
+        bitops_csa_avx2(foursA, twos, twos, twosA, twosB);
+        bitops_csa_avx2(twosA, ones, ones, load(i + 4), load(i + 5));
+        bitops_csa_avx2(twosB, ones, ones, load(i + 6), load(i + 7));
+        bitops_csa_avx2(foursB, twos, twos, twosA, twosB);
+        bitops_csa_avx2(eightsA, fours, fours, foursA, foursB);
+        bitops_csa_avx2(twosA, ones, ones, load(i + 8), load(i + 9));
+        bitops_csa_avx2(twosB, ones, ones, load(i + 10), load(i + 11));
+        bitops_csa_avx2(foursA, twos, twos, twosA, twosB);
+        bitops_csa_avx2(twosA, ones, ones, load(i + 12), load(i + 13));
+        bitops_csa_avx2(twosB, ones, ones, load(i + 14), load(i + 15));
+        bitops_csa_avx2(foursB, twos, twos, twosA, twosB);
+        bitops_csa_avx2(eightsB, fours, fours, foursA, foursB);
+        bitops_csa_avx2(sixteens, eights, eights, eightsA, eightsB);
+
+        total = _mm256_add_epi64(total, bitops_popcount_avx2(sixteens));
+    }
+
+    total = _mm256_slli_epi64(total, 4);
+    total = _mm256_add_epi64(total, _mm256_slli_epi64(bitops_popcount_avx2(eights), 3));
+    total = _mm256_add_epi64(total, _mm256_slli_epi64(bitops_popcount_avx2(fours), 2));
+    total = _mm256_add_epi64(total, _mm256_slli_epi64(bitops_popcount_avx2(twos), 1));
+    total = _mm256_add_epi64(total, bitops_popcount_avx2(ones));
+
+    for (/**/; i < n; i++) {
+        total = _mm256_add_epi64(total, bitops_popcount_avx2(load(i)));
+    }
+
+    return uint64_t(_mm256_extract_epi64(total, 0))
+         + uint64_t(_mm256_extract_epi64(total, 1))
+         + uint64_t(_mm256_extract_epi64(total, 2))
+         + uint64_t(_mm256_extract_epi64(total, 3));
+}
+
+
+__attribute__((target("avx2")))
+inline size_t bitops_popcount_avx2(const uint64_t* a, size_t n) {
+    const size_t vectors = n / 4;
+    const size_t k = bitops_harley_seal_avx2(vectors, bitops_load_avx2{reinterpret_cast<const __m256i*>(a)});
+
+    return k + bitops_popcount_scalar(a + 4 * vectors, n % 4);
+}
+
+
+__attribute__((target("avx2")))
+inline size_t bitops_and_count_avx2(uint64_t* c, const uint64_t* a, const uint64_t* b, size_t n) {
+    const size_t vectors = n / 4;
+    const size_t k = bitops_harley_seal_avx2(vectors, bitops_and_store_avx2{
+                        reinterpret_cast<__m256i*>(c),
+                        reinterpret_cast<const __m256i*>(a),
+                        reinterpret_cast<const __m256i*>(b)});
+
+    const size_t tail = 4 * vectors;
+    return k + bitops_and_count_scalar(c + tail, a + tail, b + tail, n % 4);
+}
+
+
+// --- AVX-512 -------------------------------------------------------------
+
+__attribute__((target("avx512f,avx512bw")))
+inline void bitops_csa_avx512(__m512i& h, __m512i& l, __m512i a, __m512i b, __m512i c) {
+    l = _mm512_ternarylogic_epi32(c, b, a, 0x96);
+    h = _mm512_ternarylogic_epi32(c, b, a, 0xe8);
+}
+
+
+// returns eight 64-bit counters
+__attribute__((target("avx512f,avx512bw")))
+inline __m512i bitops_popcount_avx512(__m512i v) {
+    const __m512i lookup = _mm512_set4_epi32(0x04030302, 0x03020201, 0x03020201, 0x02010100);
+    const __m512i low_mask = _mm512_set1_epi8(0x0f);
+
+    const __m512i lo = _mm512_and_si512(v, low_mask);
+    const __m512i hi = _mm512_and_si512(_mm512_srli_epi16(v, 4), low_mask);
+    const __m512i cnt = _mm512_add_epi8(_mm512_shuffle_epi8(lookup, lo),
+                                        _mm512_shuffle_epi8(lookup, hi));
+
+    return _mm512_sad_epu8(cnt, _mm512_setzero_si512());
+}
+
+
+struct bitops_load_avx512 {
+    const uint64_t* a;
+
+    __attribute__((target("avx512f,avx512bw")))
+    __m512i operator()(size_t i) const {
+        return _mm512_loadu_si512(a + 8 * i);
+    }
+};
+
+
+struct bitops_and_store_avx512 {
+    uint64_t* c;
+    const uint64_t* a;
+    const uint64_t* b;
+
+    __attribute__((target("avx512f,avx512bw")))
+    __m512i operator()(size_t i) const {
+        const __m512i v = _mm512_and_si512(_mm512_loadu_si512(a + 8 * i), _mm512_loadu_si512(b + 8 * i));
+        _mm512_storeu_si512(c + 8 * i, v);
+        return v;
+    }
+};
+
+
+template <typename LOAD>
+__attribute__((target("avx512f,avx512bw")))
+inline size_t bitops_harley_seal_avx512(size_t n, LOAD load) {
+    __m512i total    = _mm512_setzero_si512();
+    __m512i ones     = _mm512_setzero_si512();
+    __m512i twos     = _mm512_setzero_si512();
+    __m512i fours    = _mm512_setzero_si512();
+    __m512i eights   = _mm512_setzero_si512();
+    __m512i sixteens;
+    __m512i twosA, twosB, foursA, foursB, eightsA, eightsB;
+
+    size_t i = 0;
+    for (/**/; i + 16 <= n; i += 16) {
+        bitops_csa_avx512(twosA, ones, ones, load(i + 0), load(i + 1));
+        bitops_csa_avx512(twosB, ones, ones, load(i + 2), load(i + 3));
+        bitops_csa_avx512(foursA, twos, twos, twosA, twosB);
+        bitops_csa_avx512(twosA, ones, ones, load(i + 4), load(i + 5));
+        bitops_csa_avx512(twosB, ones, ones, load(i + 6), load(i + 7));
+        bitops_csa_avx512(foursB, twos, twos, twosA, twosB);
+        bitops_csa_avx512(eightsA, fours, fours, foursA, foursB);
+        bitops_csa_avx512(twosA, ones, ones, load(i + 8), load(i + 9));
+        bitops_csa_avx512(twosB, ones, ones, load(i + 10), load(i + 11));
+        bitops_csa_avx512(foursA, twos, twos, twosA, twosB);
+        bitops_csa_avx512(twosA, ones, ones, load(i + 12), load(i + 13));
+        bitops_csa_avx512(twosB, ones, ones, load(i + 14), load(i + 15));
+        bitops_csa_avx512(foursB, twos, twos, twosA, twosB);
+        bitops_csa_avx512(eightsB, fours, fours, foursA, foursB);
+        bitops_csa_avx512(sixteens, eights, eights, eightsA, eightsB);
+
+        total = _mm512_add_epi64(total, bitops_popcount_avx512(sixteens));
+    }
+
+    // masked shifts, as the unmasked ones trigger false -Wuninitialized in GCC
+    const __mmask8 all = 0xff;
+    total = _mm512_maskz_slli_epi64(all, total, 4);
+    total = _mm512_add_epi64(total, _mm512_maskz_slli_epi64(all, bitops_popcount_avx512(eights), 3));
+    total = _mm512_add_epi64(total, _mm512_maskz_slli_epi64(all, bitops_popcount_avx512(fours), 2));
+    total = _mm512_add_epi64(total, _mm512_maskz_slli_epi64(all, bitops_popcount_avx512(twos), 1));
+    total = _mm512_add_epi64(total, bitops_popcount_avx512(ones));
+
+    for (/**/; i < n; i++) {
+        total = _mm512_add_epi64(total, bitops_popcount_avx512(load(i)));
+    }
+
+    uint64_t counters[8];
+    _mm512_storeu_si512(counters, total);
+
+    return counters[0] + counters[1] + counters[2] + counters[3]
+         + counters[4] + counters[5] + counters[6] + counters[7];
+}
+
+
+__attribute__((target("avx512f,avx512bw")))
+inline size_t bitops_popcount_avx512(const uint64_t* a, size_t n) {
+    const size_t vectors = n / 8;
+    const size_t k = bitops_harley_seal_avx512(vectors, bitops_load_avx512{a});
+
+    return k + bitops_popcount_scalar(a + 8 * vectors, n % 8);
+}
+
+
+__attribute__((target("avx512f,avx512bw")))
+inline size_t bitops_and_count_avx512(uint64_t* c, const uint64_t* a, const uint64_t* b, size_t n) {
+    const size_t vectors = n / 8;
+    const size_t k = bitops_harley_seal_avx512(vectors, bitops_and_store_avx512{c, a, b});
+
+    const size_t tail = 8 * vectors;
+    return k + bitops_and_count_scalar(c + tail, a + tail, b + tail, n % 8);
+}
+
+#endif // defined(__x86_64__)
+
+
+// Returns all kernels supported by the CPU, the best one is the last.
+inline std::vector<bitops_kernel> bitops_kernels() {
+    std::vector<bitops_kernel> kernels;
+    kernels.push_back({"scalar", bitops_popcount_scalar, bitops_and_count_scalar});
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back({"AVX2", bitops_popcount_avx2, bitops_and_count_avx2});
+    }
+    if (__builtin_cpu_supports("avx512bw")) {
+        kernels.push_back({"AVX512BW", bitops_popcount_avx512, bitops_and_count_avx512});
+    }
+#endif
+
+    return kernels;
+}
+
+
+inline const bitops_kernel& bitops() {
+    static const bitops_kernel kernel = bitops_kernels().back();
+
+    return kernel;
+}
+
+
+inline size_t bitops_popcount(const uint64_t* a, size_t n) {
+    return bitops().popcount(a, n);
+}
+
+
+inline size_t bitops_and_count(uint64_t* c, const uint64_t* a, const uint64_t* b, size_t n) {
+    return bitops().and_count(c, a, b, n);
+}
+
+
+// Row ids of set bits are collected in a buffer and passed to
+// callback(const uint32_t* ids, size_t count) in batches; once the
+// callback returns false, decoding stops.
+constexpr size_t bitops_batch_size = 256;
+
+template <typename CALLBACK>
+class bitops_decoder {
+
+    CALLBACK& callback;
+    size_t count = 0;
+    bool stopped = false;
+    // a word yields at most 64 ids, decoding might write 3 ids past them
+    uint32_t buffer[bitops_batch_size + 64 + 3];
+
+public:
+    bitops_decoder(CALLBACK& callback_) : callback(callback_) {}
+
+    // Bit j of a[i] is the row id base + 64 * i + j. Returns false if
+    // the callback has stopped decoding.
+    bool add(const uint64_t* a, size_t n, size_t base) {
+        if (stopped) {
+            return false;
+        }
+
+        for (size_t i=0; i < n; i++) {
+            uint64_t word = a[i];
+            if (word == 0) {
+                continue;
+            }
+
+            const uint32_t offset = base + 64 * i;
+            const size_t k = __builtin_popcountll(word);
+            uint32_t* out = buffer + count;
+
+            // unrolled tzcnt/blsr loop with a fixed trip count avoids
+            // a mispredicted branch per bit; the highest bit forced
+            // in zero words keeps ctz defined for the excess ids
+            for (size_t j=0; j < k; j += 4) {
+                out[j + 0] = offset + __builtin_ctzll(word | (uint64_t(1) << 63));
+                word &= word - 1;
+                out[j + 1] = offset + __builtin_ctzll(word | (uint64_t(1) << 63));
+                word &= word - 1;
+                out[j + 2] = offset + __builtin_ctzll(word | (uint64_t(1) << 63));
+                word &= word - 1;
+                out[j + 3] = offset + __builtin_ctzll(word | (uint64_t(1) << 63));
+                word &= word - 1;
+            }
+
+            count += k;
+            if (count >= bitops_batch_size && !flush()) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool flush() {
+        if (count > 0 && !stopped) {
+            stopped = !callback(static_cast<const uint32_t*>(buffer), count);
+            count = 0;
+        }
+
+        return !stopped;
+    }
+};
+
+
+// callback(ids, count) returns false to stop
+template <typename CALLBACK>
+inline void bitops_visit_batches_until(const uint64_t* a, size_t n, size_t base, CALLBACK callback) {
+    bitops_decoder<CALLBACK> decoder(callback);
+    if (decoder.add(a, n, base)) {
+        decoder.flush();
+    }
+}
+
+
+template <typename CALLBACK>
+inline void bitops_visit_batches(const uint64_t* a, size_t n, size_t base, CALLBACK callback) {
+    bitops_visit_batches_until(a, n, base, [&callback](const uint32_t* ids, size_t count) {
+        callback(ids, count);
+        return true;
+    });
+}
@@ -0,0 +1,353 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#if defined(__x86_64__)
+#   include <immintrin.h>
+#endif
+
+// Sorted list of row ids compressed in blocks of 128 ids.
+//
+// A block stores differences between consecutive ids in the StreamVByte
+// format: 32 control bytes (2 bits per id: length of difference - 1) followed
+// by 1..4 data bytes per difference. The skip table holds the first id and
+// the offset of each block, thus a search decodes only a single block.
+// The last, incomplete block is kept uncompressed.
+class bitvector_compressed {
+
+public:
+    static constexpr size_t block_size = 128;
+
+private:
+    static constexpr size_t control_size = block_size / 4;
+    static constexpr size_t padding = 16; // SIMD decoder might read past the last block
+
+    struct skip_entry {
+        uint32_t first;     // the first id in block
+        uint32_t offset;    // offset of the block in `bytes`
+    };
+
+    size_t m_size;
+    size_t m_cardinality = 0;
+    ssize_t last_set = -1;
+    std::vector<skip_entry> skip;
+    std::vector<uint8_t> bytes;
+    std::vector<uint32_t> tail;
+
+public:
+    // the largest index that can be set
+    static constexpr size_t max_index = std::numeric_limits<uint32_t>::max();
+
+    bitvector_compressed(size_t n) : m_size(n) {}
+
+    void set(size_t index) {
+        assert(index < m_size);
+        if (ssize_t(index) == last_set) {
+            return;
+        }
+
+        assert(ssize_t(index) > last_set);
+        last_set = index;
+        tail.push_back(index);
+        m_cardinality += 1;
+        if (tail.size() == block_size) {
+            encode_block(tail.data());
+            tail.clear();
+        }
+    }
+
+    void reserve(size_t cardinality) {
+        skip.reserve(cardinality / block_size);
+        tail.reserve(std::min(cardinality, block_size));
+    }
+
+    void update_internal_structures() {
+        skip.shrink_to_fit();
+        bytes.shrink_to_fit();
+        tail.shrink_to_fit();
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+
+    size_t cardinality() const {
+        return m_cardinality;
+    }
+
+    size_t size_in_bytes() const {
+        size_t total = 0;
+
+        total += sizeof(*this);
+        total += skip.capacity() * sizeof(skip_entry);
+        total += bytes.capacity();
+        total += tail.capacity() * sizeof(uint32_t);
+
+        return total;
+    }
+
+    template <typename CALLBACK>
+    void visit(CALLBACK callback) const {
+        visit_batches([&callback](const uint32_t* ids, size_t n) {
+            for (size_t i=0; i < n; i++) {
+                callback(ids[i]);
+            }
+        });
+    }
+
+    // callback(const uint32_t* ids, size_t n) gets ids in ascending order
+    template <typename CALLBACK>
+    void visit_batches(CALLBACK callback) const {
+        visit_batches_until([&callback](const uint32_t* ids, size_t n) {
+            callback(ids, n);
+            return true;
+        });
+    }
+
+    // Like visit_batches, but stops as soon as callback returns false.
+    template <typename CALLBACK>
+    void visit_batches_until(CALLBACK callback) const {
+        uint32_t buffer[block_size];
+        for (size_t i=0; i < skip.size(); i++) {
+            decode_block(i, buffer);
+            if (!callback(static_cast<const uint32_t*>(buffer), block_size)) {
+                return;
+            }
+        }
+
+        if (!tail.empty()) {
+            callback(tail.data(), tail.size());
+        }
+    }
+
+private:
+    void encode_block(const uint32_t* ids) {
+        if (!bytes.empty()) {
+            bytes.resize(bytes.size() - padding);
+        }
+
+        skip.push_back({ids[0], uint32_t(bytes.size())});
+
+        const size_t control = bytes.size();
+        bytes.resize(control + control_size, 0);
+
+        uint32_t prev = ids[0];
+        for (size_t i=0; i < block_size; i++) {
+            const uint32_t delta = ids[i] - prev;
+            prev = ids[i];
+
+            const size_t length = (delta < (1 << 8)) ? 1 : (delta < (1 << 16)) ? 2 : (delta < (1 << 24)) ? 3 : 4;
+            bytes[control + i / 4] |= (length - 1) << (2 * (i % 4));
+            for (size_t j=0; j < length; j++) {
+                bytes.push_back(delta >> (8 * j));
+            }
+        }
+
+        bytes.resize(bytes.size() + padding, 0);
+    }
+
+    void decode_block(size_t block, uint32_t* out) const {
+        static const decode_fn decode = decoder();
+
+        decode(bytes.data() + skip[block].offset, skip[block].first, out);
+    }
+
+    using decode_fn = void (*)(const uint8_t* block, uint32_t first, uint32_t* out);
+
+    static void decode_scalar(const uint8_t* block, uint32_t first, uint32_t* out) {
+        const uint8_t* control = block;
+        const uint8_t* data = block + control_size;
+
+        uint32_t prev = first;
+        for (size_t i=0; i < block_size; i++) {
+            const size_t length = ((control[i / 4] >> (2 * (i % 4))) & 0x3) + 1;
+
+            uint32_t delta = 0;
+            memcpy(&delta, data, length); // little-endian
+            data += length;
+
+            prev += delta;
+            out[i] = prev;
+        }
+    }
+
+#if defined(__x86_64__)
+    struct shuffle_tables {
+        uint8_t shuffle[256][16];
+        uint8_t length[256];
+
+        shuffle_tables() {
+            for (size_t c=0; c < 256; c++) {
+                size_t offset = 0;
+                for (size_t i=0; i < 4; i++) {
+                    const size_t n = ((c >> (2 * i)) & 0x3) + 1;
+                    for (size_t j=0; j < 4; j++) {
+                        shuffle[c][4 * i + j] = (j < n) ? offset + j : 0x80;
+                    }
+                    offset += n;
+                }
+
+                length[c] = offset;
+            }
+        }
+    };
+
+    // Each control byte describes four differences: pshufb expands their
+    // bytes to 32-bit words, then the words are prefix-summed.
+    __attribute__((target("ssse3")))
+    static void decode_ssse3(const uint8_t* block, uint32_t first, uint32_t* out) {
+        static const shuffle_tables tables;
+
+        const uint8_t* control = block;
+        const uint8_t* data = block + control_size;
+
+        __m128i prev = _mm_set1_epi32(first);
+        for (size_t i=0; i < control_size; i++) {
+            const uint8_t c = control[i];
+
+            const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+            const __m128i mask  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.shuffle[c]));
+            __m128i delta = _mm_shuffle_epi8(input, mask);
+            data += tables.length[c];
+
+            delta = _mm_add_epi32(delta, _mm_slli_si128(delta, 4));
+            delta = _mm_add_epi32(delta, _mm_slli_si128(delta, 8));
+            prev  = _mm_add_epi32(delta, prev);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * i), prev);
+
+            prev = _mm_shuffle_epi32(prev, 0xff);
+        }
+    }
+#endif
+
+    static decode_fn decoder() {
+#if defined(__x86_64__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("ssse3")) {
+            return decode_ssse3;
+        }
+#endif
+        return decode_scalar;
+    }
+
+    // Moves forward through the ids of a bitvector; blocks that contain
+    // no searched id are skipped without decoding.
+    class reader {
+        const bitvector_compressed& bv;
+        size_t block = 0;                   // current block, skip.size() denotes the tail
+        uint32_t buffer[block_size];
+        const uint32_t* first = nullptr;    // decoded ids of the current block
+        const uint32_t* last  = nullptr;
+
+    public:
+        reader(const bitvector_compressed& bv_) : bv(bv_) {
+            load(0);
+        }
+
+        // Returns true if id is present; searched ids must be ascending.
+        bool contains(uint32_t id) {
+            if (first == last || last[-1] < id) {
+                // the last block with the first id not greater than id
+                const size_t blocks = bv.skip.size();
+                size_t next = block + 1;
+                auto it = std::upper_bound(bv.skip.begin() + std::min(next, blocks), bv.skip.end(), id,
+                                           [](uint32_t id, const skip_entry& e) { return id < e.first; });
+                next = std::max(next, size_t(it - bv.skip.begin()));
+                if (next == blocks && !bv.tail.empty() && bv.tail[0] <= id) {
+                    next = blocks + 1;
+                }
+
+                load(next - 1);
+            }
+
+            first = std::lower_bound(first, last, id);
+            return first != last && *first == id;
+        }
+
+    private:
+        void load(size_t b) {
+            if (block == b && first != nullptr) {
+                return;
+            }
+
+            block = b;
+            if (b < bv.skip.size()) {
+                bv.decode_block(b, buffer);
+                first = buffer;
+                last  = buffer + block_size;
+            } else {
+                first = bv.tail.data();
+                last  = first + bv.tail.size();
+            }
+        }
+    };
+
+public:
+    static std::optional<bitvector_compressed> bit_and(const bitvector_compressed& v1, const bitvector_compressed& v2) {
+        assert(v1.size() == v2.size());
+
+        const bitvector_compressed& smaller = (v1.cardinality() <= v2.cardinality()) ? v1 : v2;
+        const bitvector_compressed& larger  = (v1.cardinality() <= v2.cardinality()) ? v2 : v1;
+
+        bitvector_compressed result(v1.size());
+        if (smaller.cardinality() == 0) {
+            return std::nullopt;
+        }
+
+        reader r(larger);
+        smaller.visit_batches([&r, &result](const uint32_t* ids, size_t n) {
+            for (size_t i=0; i < n; i++) {
+                if (r.contains(ids[i])) {
+                    result.set(ids[i]);
+                }
+            }
+        });
+
+        if (result.cardinality() == 0) {
+            return std::nullopt;
+        }
+
+        result.update_internal_structures();
+        return result;
+    }
+
+    static bool bit_and_inplace(bitvector_compressed& v1, const bitvector_compressed& v2) {
+        auto tmp = bit_and(v1, v2);
+        if (!tmp.has_value()) {
+            v1 = bitvector_compressed(v1.size());
+            return false;
+        }
+
+        v1 = std::move(tmp.value());
+        return true;
+    }
+
+    static void bit_or_inplace(bitvector_compressed& v1, const bitvector_compressed& v2) {
+        assert(v1.size() == v2.size());
+
+        std::vector<uint32_t> a;
+        std::vector<uint32_t> b;
+        a.reserve(v1.cardinality());
+        b.reserve(v2.cardinality());
+        v1.visit_batches([&a](const uint32_t* ids, size_t n) { a.insert(a.end(), ids, ids + n); });
+        v2.visit_batches([&b](const uint32_t* ids, size_t n) { b.insert(b.end(), ids, ids + n); });
+
+        std::vector<uint32_t> ids;
+        std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(ids));
+
+        bitvector_compressed result(v1.size());
+        for (const uint32_t id: ids) {
+            result.set(id);
+        }
+
+        result.update_internal_structures();
+        v1 = std::move(result);
+    }
+};
@@ -0,0 +1,421 @@
+#pragma once
+
+#include "bitops.h"
+#include "container_facade.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <vector>
+
+// Set of row ids kept in one of three representations:
+//
+// * array - sorted ids;
+// * dense - bitmap;
+// * runs  - sorted, disjoint ranges of consecutive ids.
+//
+// Ids are collected in an array, update_internal_structures() picks the
+// smallest representation for the final set. Unlike roaring, the choice
+// is made for whole bitvector, not for 64K-id chunks.
+class bitvector_hybrid {
+
+public:
+    enum class representation: uint8_t {
+        array,
+        dense,
+        runs
+    };
+
+private:
+    struct run {
+        uint32_t first;
+        uint32_t last;      // inclusive
+    };
+
+    size_t m_size;
+    size_t m_cardinality = 0;
+    representation kind = representation::array;
+
+    std::vector<uint32_t> array;
+    std::vector<uint64_t> words;
+    std::vector<run> runs;
+
+    size_t words_count() const {
+        return (m_size + 63) / 64;
+    }
+
+public:
+    // the largest index that can be set
+    static constexpr size_t max_index = std::numeric_limits<uint32_t>::max();
+
+    bitvector_hybrid(size_t n) : m_size(n) {}
+
+    void set(size_t index) {
+        assert(index < m_size);
+        if (kind != representation::array) {
+            to_array();
+        }
+
+        if (!array.empty() && array.back() == index) {
+            return;
+        }
+
+        assert(array.empty() || array.back() < index);
+        array.push_back(index);
+        m_cardinality += 1;
+    }
+
+    void reserve(size_t cardinality) {
+        if (kind == representation::array) {
+            array.reserve(cardinality);
+        }
+    }
+
+    // Picks the representation that needs the least memory.
+    void update_internal_structures() {
+        to_array();
+
+        size_t runs_count = 0;
+        for (size_t i=0; i < array.size(); i++) {
+            runs_count += (i == 0 || array[i] != array[i - 1] + 1);
+        }
+
+        const size_t array_bytes = array.size() * sizeof(uint32_t);
+        const size_t dense_bytes = words_count() * sizeof(uint64_t);
+        const size_t runs_bytes  = runs_count * sizeof(run);
+
+        if (runs_bytes < array_bytes && runs_bytes < dense_bytes) {
+            to_runs();
+        } else if (dense_bytes < array_bytes) {
+            to_dense();
+        }
+
+        array.shrink_to_fit();
+        words.shrink_to_fit();
+        runs.shrink_to_fit();
+    }
+
+    representation get_representation() const {
+        return kind;
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+
+    size_t cardinality() const {
+        return m_cardinality;
+    }
+
+    size_t size_in_bytes() const {
+        size_t total = 0;
+
+        total += sizeof(*this);
+        total += array.capacity() * sizeof(uint32_t);
+        total += words.capacity() * sizeof(uint64_t);
+        total += runs.capacity() * sizeof(run);
+
+        return total;
+    }
+
+    template <typename CALLBACK>
+    void visit(CALLBACK callback) const {
+        visit_batches([&callback](const uint32_t* ids, size_t n) {
+            for (size_t i=0; i < n; i++) {
+                callback(ids[i]);
+            }
+        });
+    }
+
+    // callback(const uint32_t* ids, size_t n) gets ids in ascending order
+    template <typename CALLBACK>
+    void visit_batches(CALLBACK callback) const {
+        visit_batches_until([&callback](const uint32_t* ids, size_t n) {
+            callback(ids, n);
+            return true;
+        });
+    }
+
+    // Like visit_batches, but stops as soon as callback returns false.
+    template <typename CALLBACK>
+    void visit_batches_until(CALLBACK callback) const {
+        switch (kind) {
+            case representation::array:
+                if (!array.empty()) {
+                    callback(array.data(), array.size());
+                }
+                break;
+
+            case representation::dense:
+                bitops_visit_batches_until(words.data(), words.size(), 0, callback);
+                break;
+
+            case representation::runs: {
+                uint32_t buffer[256];
+                size_t n = 0;
+                for (const auto& r: runs) {
+                    for (uint64_t id=r.first; id <= r.last; id++) {
+                        buffer[n++] = id;
+                        if (n == std::size(buffer)) {
+                            if (!callback(static_cast<const uint32_t*>(buffer), n)) {
+                                return;
+                            }
+                            n = 0;
+                        }
+                    }
+                }
+
+                if (n > 0) {
+                    callback(static_cast<const uint32_t*>(buffer), n);
+                }
+                break;
+            }
+        }
+    }
+
+private:
+    void to_array() {
+        if (kind == representation::array) {
+            return;
+        }
+
+        std::vector<uint32_t> tmp;
+        tmp.reserve(m_cardinality);
+        visit_batches([&tmp](const uint32_t* ids, size_t n) {
+            tmp.insert(tmp.end(), ids, ids + n);
+        });
+
+        set_array(std::move(tmp));
+    }
+
+    void to_dense() {
+        assert(kind == representation::array);
+
+        words.assign(words_count(), 0);
+        for (const uint32_t id: array) {
+            words[id / 64] |= uint64_t(1) << (id % 64);
+        }
+
+        array = {};
+        kind = representation::dense;
+    }
+
+    void to_runs() {
+        assert(kind == representation::array);
+
+        runs.clear();
+        for (const uint32_t id: array) {
+            if (!runs.empty() && runs.back().last + 1 == id) {
+                runs.back().last = id;
+            } else {
+                runs.push_back({id, id});
+            }
+        }
+
+        array = {};
+        kind = representation::runs;
+    }
+
+    void set_array(std::vector<uint32_t>&& ids) {
+        array = std::move(ids);
+        words = {};
+        runs  = {};
+        m_cardinality = array.size();
+        kind = representation::array;
+    }
+
+    // A dense result of AND might be better stored as an array.
+    void shrink_dense() {
+        if (m_cardinality * sizeof(uint32_t) < words_count() * sizeof(uint64_t)) {
+            to_array();
+        }
+    }
+
+private:
+    // AND kernels for all pairs of representations
+
+    static void and_dense_dense(bitvector_hybrid& result, const bitvector_hybrid& a, const bitvector_hybrid& b) {
+        if (&result != &a) {
+            result.words.resize(a.words.size());
+        }
+
+        result.m_cardinality = bitops_and_count(result.words.data(), a.words.data(), b.words.data(), a.words.size());
+        result.kind = representation::dense;
+        result.shrink_dense();
+    }
+
+    static std::vector<uint32_t> and_dense_array(const bitvector_hybrid& a, const bitvector_hybrid& b) {
+        std::vector<uint32_t> out;
+        for (const uint32_t id: b.array) {
+            if (a.words[id / 64] & (uint64_t(1) << (id % 64))) {
+                out.push_back(id);
+            }
+        }
+
+        return out;
+    }
+
+    static void and_dense_runs(bitvector_hybrid& result, const bitvector_hybrid& a, const bitvector_hybrid& b) {
+        std::vector<uint64_t> out(a.words.size(), 0);
+        for (const auto& r: b.runs) {
+            const size_t first = r.first / 64;
+            const size_t last  = r.last / 64;
+            for (size_t i=first; i <= last; i++) {
+                uint64_t mask = ~uint64_t(0);
+                if (i == first) {
+                    mask &= ~uint64_t(0) << (r.first % 64);
+                }
+                if (i == last) {
+                    mask &= ~uint64_t(0) >> (63 - r.last % 64);
+                }
+
+                // a word might be shared by several runs
+                out[i] |= a.words[i] & mask;
+            }
+        }
+
+        result.array = {};
+        result.runs  = {};
+        result.words = std::move(out);
+        result.m_cardinality = bitops_popcount(result.words.data(), result.words.size());
+        result.kind = representation::dense;
+        result.shrink_dense();
+    }
+
+    static std::vector<uint32_t> and_array_array(const bitvector_hybrid& a, const bitvector_hybrid& b) {
+        const index_range lists[2] = {
+            {a.array.data(), a.array.data() + a.array.size()},
+            {b.array.data(), b.array.data() + b.array.size()}
+        };
+
+        std::vector<uint32_t> out(std::min(a.array.size(), b.array.size()));
+        out.resize(intersect_many(lists, 2, out.data()));
+
+        return out;
+    }
+
+    static std::vector<uint32_t> and_array_runs(const bitvector_hybrid& a, const bitvector_hybrid& b) {
+        std::vector<uint32_t> out;
+        auto r = b.runs.begin();
+        for (const uint32_t id: a.array) {
+            while (r != b.runs.end() && r->last < id) {
+                ++r;
+            }
+
+            if (r == b.runs.end()) {
+                break;
+            }
+
+            if (r->first <= id) {
+                out.push_back(id);
+            }
+        }
+
+        return out;
+    }
+
+    static void and_runs_runs(bitvector_hybrid& result, const bitvector_hybrid& a, const bitvector_hybrid& b) {
+        std::vector<run> out;
+        size_t cardinality = 0;
+
+        auto r1 = a.runs.begin();
+        auto r2 = b.runs.begin();
+        while (r1 != a.runs.end() && r2 != b.runs.end()) {
+            const uint32_t first = std::max(r1->first, r2->first);
+            const uint32_t last  = std::min(r1->last, r2->last);
+            if (first <= last) {
+                out.push_back({first, last});
+                cardinality += last - first + 1;
+            }
+
+            if (r1->last < r2->last) {
+                ++r1;
+            } else {
+                ++r2;
+            }
+        }
+
+        result.array = {};
+        result.words = {};
+        result.runs  = std::move(out);
+        result.m_cardinality = cardinality;
+        result.kind = representation::runs;
+    }
+
+    // result might be the same object as v1 or v2
+    static void and_aux(bitvector_hybrid& result, const bitvector_hybrid& v1, const bitvector_hybrid& v2) {
+        assert(v1.size() == v2.size());
+
+        // order operands: array < dense < runs
+        auto rank = [](representation k) {
+            return (k == representation::array) ? 0 : (k == representation::dense) ? 1 : 2;
+        };
+
+        const bool swap = rank(v1.kind) > rank(v2.kind);
+        const bitvector_hybrid& a = swap ? v2 : v1;
+        const bitvector_hybrid& b = swap ? v1 : v2;
+
+        switch (a.kind) {
+            case representation::array:
+                if (b.kind == representation::array) {
+                    result.set_array(and_array_array(a, b));
+                } else if (b.kind == representation::dense) {
+                    result.set_array(and_dense_array(b, a));
+                } else {
+                    result.set_array(and_array_runs(a, b));
+                }
+                break;
+
+            case representation::dense:
+                if (b.kind == representation::dense) {
+                    and_dense_dense(result, (&result == &b) ? b : a, (&result == &b) ? a : b);
+                } else {
+                    and_dense_runs(result, a, b);
+                }
+                break;
+
+            case representation::runs:
+                and_runs_runs(result, a, b);
+                break;
+        }
+    }
+
+public:
+    static std::optional<bitvector_hybrid> bit_and(const bitvector_hybrid& v1, const bitvector_hybrid& v2) {
+        bitvector_hybrid result(v1.size());
+        and_aux(result, v1, v2);
+        if (result.m_cardinality == 0) {
+            return std::nullopt;
+        }
+
+        return result;
+    }
+
+    static bool bit_and_inplace(bitvector_hybrid& v1, const bitvector_hybrid& v2) {
+        and_aux(v1, v1, v2);
+
+        return v1.m_cardinality > 0;
+    }
+
+    // The result is an array, update_internal_structures() picks
+    // the final representation.
+    static void bit_or_inplace(bitvector_hybrid& v1, const bitvector_hybrid& v2) {
+        assert(v1.size() == v2.size());
+
+        v1.to_array();
+        std::vector<uint32_t> ids;
+        ids.reserve(v2.cardinality());
+        v2.visit_batches([&ids](const uint32_t* batch, size_t n) {
+            ids.insert(ids.end(), batch, batch + n);
+        });
+
+        std::vector<uint32_t> tmp;
+        tmp.reserve(v1.cardinality() + ids.size());
+        std::set_union(v1.array.begin(), v1.array.end(), ids.begin(), ids.end(), std::back_inserter(tmp));
+
+        v1.set_array(std::move(tmp));
+    }
+};
@@ -1,22 +1,26 @@
 #pragma once
 
+#include "bitops.h"
+#include <limits>
 #include <memory>
 #include <optional>
+#include <stdexcept>
 
 class bitvector_naive {
 
-public:
-    static constexpr bool custom_filter = false;
-
 protected:
     size_t m_size;
     uint64_t* data;
+    bool owner = true; // false if data points to external memory, see view()
 
     size_t chunks_count() const noexcept {
         return (m_size + 63) / 64;
     }
 
 public:
+    // the largest index that can be set
+    static constexpr size_t max_index = std::numeric_limits<uint32_t>::max();
+
     bitvector_naive(size_t n) : bitvector_naive(n, true) {
         memset(data, 0, chunks_count() * sizeof(uint64_t));
     }
@@ -27,29 +31,37 @@ public:
         memcpy(data, bv.data, chunks_count() * sizeof(uint64_t));
     }
 
-    bitvector_naive(bitvector_naive&& bv)
+    bitvector_naive(bitvector_naive&& bv) noexcept
         : m_size(bv.m_size)
-        , data(bv.data) {
+        , data(bv.data)
+        , owner(bv.owner) {
 
         bv.data = nullptr;
     }
 
     bitvector_naive& operator=(bitvector_naive&& bv) {
-        delete[] data;
+        if (owner) {
+            delete[] data;
+        }
 
         m_size  = bv.m_size;
         data    = bv.data;
+        owner   = bv.owner;
         bv.data = nullptr;
 
         return *this;
     }
 
     ~bitvector_naive() {
-        delete[] data;
+        if (owner) {
+            delete[] data;
+        }
     }
 
     void set(size_t index) {
 
+        assert(owner);
+
         const size_t n = index / 64;
         const size_t k = index % 64;
 
@@ -70,38 +82,35 @@ public:
     }
 
     size_t cardinality() const {
-        size_t k = 0;
-        for (size_t i=0; i < chunks_count(); i++) {
-            k += __builtin_popcountll(data[i]);
-        }
-
-        return k;
+        return bitops_popcount(data, chunks_count());
     }
 
     template <typename CALLBACK>
     void visit(CALLBACK callback) const {
-        for (size_t i=0; i < chunks_count(); i++) {
-            uint64_t tmp = data[i];
-
-            size_t k = i * 64;
-            while (tmp) {
-#if 1
-                if (tmp & 0x1) {
-                    callback(k);
-                }
-
-                tmp >>= 1;
-                k += 1;
-#else
-                const uint64_t t = tmp & (~tmp + 1);
-                const uint64_t r = __builtin_ctzll(t);
-                callback(k + r);
-                tmp ^= t;
-#endif
+        visit_batches([&callback](const uint32_t* ids, size_t n) {
+            for (size_t i=0; i < n; i++) {
+                callback(ids[i]);
             }
-        }
+        });
     }
 
+    // callback(const uint32_t* ids, size_t n) gets ids in ascending order
+    template <typename CALLBACK>
+    void visit_batches(CALLBACK callback) const {
+        visit_batches_until([&callback](const uint32_t* ids, size_t n) {
+            callback(ids, n);
+            return true;
+        });
+    }
+
+    // Like visit_batches, but stops as soon as callback returns false.
+    template <typename CALLBACK>
+    void visit_batches_until(CALLBACK callback) const {
+        bitops_visit_batches_until(data, chunks_count(), 0, callback);
+    }
+
+    void reserve(size_t /*cardinality*/) {}
+
     void update_internal_structures() {}
 
 private:
@@ -109,14 +118,50 @@ private:
         : m_size(size)
         , data(new uint64_t[chunks_count()]) {}
 
+    bitvector_naive(size_t size, const uint64_t* external)
+        : m_size(size)
+        , data(const_cast<uint64_t*>(external))
+        , owner(false) {}
+
+    // Copies the data of a view, thus the bitvector might be modified.
+    void materialize() {
+        if (!owner) {
+            uint64_t* copy = new uint64_t[chunks_count()];
+            memcpy(copy, data, chunks_count() * sizeof(uint64_t));
+            data  = copy;
+            owner = true;
+        }
+    }
+
+public:
+    static constexpr uint32_t file_tag = 1;
+
+    size_t serialized_size() const {
+        return chunks_count() * sizeof(uint64_t);
+    }
+
+    void serialize(char* out) const {
+        memcpy(out, data, serialized_size());
+    }
+
+    // Returns a read-only bitvector that refers to serialized data; the data
+    // has to be 8-byte aligned and must outlive the bitvector.
+    static bitvector_naive view(size_t size, const char* ptr, size_t bytes) {
+        bitvector_naive bv(size, reinterpret_cast<const uint64_t*>(ptr));
+        if (bytes != bv.serialized_size()) {
+            throw std::runtime_error("bitvector_naive: invalid serialized size");
+        }
+
+        return bv;
+    }
+
 public:
     static std::optional<bitvector_naive> bit_and(const bitvector_naive& v1, const bitvector_naive& v2) {
         assert(v1.size() == v2.size());
 
         bitvector_naive result(v1.size(), true);
-
-        for (size_t i=0; i < result.chunks_count(); i++) {
-            result.data[i] = v1.data[i] & v2.data[i];
+        if (bitops_and_count(result.data, v1.data, v2.data, result.chunks_count()) == 0) {
+            return std::nullopt;
         }
 
         return result;
@@ -125,11 +170,17 @@ public:
     static bool bit_and_inplace(bitvector_naive& v1, const bitvector_naive& v2) {
         assert(v1.size() == v2.size());
 
+        v1.materialize();
+        return bitops_and_count(v1.data, v1.data, v2.data, v1.chunks_count()) > 0;
+    }
+
+    static void bit_or_inplace(bitvector_naive& v1, const bitvector_naive& v2) {
+        assert(v1.size() == v2.size());
+
+        v1.materialize();
         for (size_t i=0; i < v1.chunks_count(); i++) {
-            v1.data[i] &= v2.data[i];
+            v1.data[i] |= v2.data[i];
         }
-
-        return true;
     }
 };
 
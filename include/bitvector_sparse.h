@@ -1,6 +1,8 @@
 #pragma once
 
+#include "bitops.h"
 #include <vector>
+#include <limits>
 #include <memory>
 #include <optional>
 
@@ -10,9 +12,6 @@
 
 class bitvector_sparse {
 
-public:
-    static constexpr bool custom_filter = false;
-
 private:
     static constexpr size_t block_size = 8; // in 64-bit units
     static constexpr size_t bits_in_chunk = 64;
@@ -28,7 +27,23 @@ protected:
         return (m_size + bits_in_block - 1) / bits_in_block;
     }
 
+    // c = a & b, returns false if c is zero. The block is too short for
+    // a dispatched bitops kernel, the fixed-size loop is unrolled and no
+    // popcount is needed.
+    static bool and_block(uint64_t* c, const uint64_t* a, const uint64_t* b) {
+        uint64_t any = 0;
+        for (size_t j=0; j < block_size; j++) {
+            c[j] = a[j] & b[j];
+            any |= c[j];
+        }
+
+        return any != 0;
+    }
+
 public:
+    // the largest index that can be set
+    static constexpr size_t max_index = std::numeric_limits<uint32_t>::max();
+
     bitvector_sparse(size_t n)
         : m_size(n)
         , blocks(blocks_count()) {}
@@ -47,7 +62,7 @@ public:
         }
     }
 
-    bitvector_sparse(bitvector_sparse&& bv)
+    bitvector_sparse(bitvector_sparse&& bv) noexcept
         : m_size(bv.m_size)
         , blocks(std::move(bv.blocks)) {}
 
@@ -121,9 +136,9 @@ public:
         for (const auto& ptr: blocks) {
             const uint64_t* data = ptr.get();
             if (data) {
-                for (size_t j=0; j < block_size; j++) {
-                    k += __builtin_popcountll(data[j]);
-                }
+                // the dispatched kernel, without -mpopcnt a loop of
+                // __builtin_popcountll is twice as slow even for 8 words
+                k += bitops_popcount(data, block_size);
             }
 
         }
@@ -133,32 +148,38 @@ public:
 
     template <typename CALLBACK>
     void visit(CALLBACK callback) const {
-        size_t block_id = 0;
-        block_id -= bits_in_block;
-        for (const auto& ptr: blocks) {
-            block_id += bits_in_block;
-
-            const uint64_t* data = ptr.get();
-            if (data == nullptr) {
-                continue;
+        visit_batches([&callback](const uint32_t* ids, size_t n) {
+            for (size_t i=0; i < n; i++) {
+                callback(ids[i]);
             }
+        });
+    }
 
-            for (size_t i=0; i < block_size; i++) {
-                uint64_t tmp = ptr.get()[i];
-                size_t k = block_id + i * bits_in_chunk;
-                while (tmp) {
-                    if (tmp & 0x1) {
-                        callback(k);
-                    }
-
-                    tmp >>= 1;
-                    k += 1;
-                }
-            }
+    // callback(const uint32_t* ids, size_t n) gets ids in ascending order
+    template <typename CALLBACK>
+    void visit_batches(CALLBACK callback) const {
+        visit_batches_until([&callback](const uint32_t* ids, size_t n) {
+            callback(ids, n);
+            return true;
+        });
+    }
 
+    // Like visit_batches, but stops as soon as callback returns false.
+    template <typename CALLBACK>
+    void visit_batches_until(CALLBACK callback) const {
+        bitops_decoder<CALLBACK> decoder(callback);
+        for (size_t i=0; i < blocks.size(); i++) {
+            const uint64_t* data = blocks[i].get();
+            if (data != nullptr && !decoder.add(data, block_size, i * bits_in_block)) {
+                return;
+            }
         }
+
+        decoder.flush();
     }
 
+    void reserve(size_t /*cardinality*/) {}
+
     void update_internal_structures() {}
 
 public:
@@ -179,10 +200,8 @@ public:
             }
 
             result.blocks[i].reset(new block_type);
-
-            uint64_t* res = result.blocks[i].get();
-            for (size_t j=0; j < block_size; j++) {
-                res[j] = data1[j] & data2[j];
+            if (!and_block(result.blocks[i].get(), data1, data2)) {
+                result.blocks[i].reset();
             }
         }
 
@@ -192,20 +211,45 @@ public:
     static bool bit_and_inplace(bitvector_sparse& v1, const bitvector_sparse& v2) {
         assert(v1.size() == v2.size());
 
+        bool empty = true;
         for (size_t i=0; i < v1.blocks_count(); i++) {
             uint64_t* data1 = v1.blocks[i].get();
             const uint64_t* data2 = v2.blocks[i].get();
             if (data1 == nullptr || data2 == nullptr) {
-                v1.blocks[i].release();
+                v1.blocks[i].reset();
                 continue;
             }
 
-            for (size_t j=0; j < block_size; j++) {
-                data1[j] &= data2[j];
+            if (!and_block(data1, data1, data2)) {
+                v1.blocks[i].reset();
+            } else {
+                empty = false;
             }
         }
 
-        return true;
+        return !empty;
+    }
+
+    static void bit_or_inplace(bitvector_sparse& v1, const bitvector_sparse& v2) {
+        assert(v1.size() == v2.size());
+
+        for (size_t i=0; i < v1.blocks_count(); i++) {
+            const uint64_t* data2 = v2.blocks[i].get();
+            if (data2 == nullptr) {
+                continue;
+            }
+
+            uint64_t* data1 = v1.blocks[i].get();
+            if (data1 == nullptr) {
+                v1.blocks[i].reset(new block_type);
+                memcpy(v1.blocks[i].get(), data2, sizeof(block_type));
+                continue;
+            }
+
+            for (size_t j=0; j < block_size; j++) {
+                data1[j] |= data2[j];
+            }
+        }
     }
 };
 
@@ -1,16 +1,17 @@
 #pragma once
 
+#include "bitops.h"
+#include <limits>
 #include <memory>
 #include <optional>
+#include <stdexcept>
 
 class bitvector_tracking {
 
-public:
-    static constexpr bool custom_filter = false;
-
 protected:
     size_t m_size;
     uint64_t* data;
+    bool owner = true; // false if data points to external memory, see view()
 
     struct {
         size_t first = 0;
@@ -27,6 +28,9 @@ protected:
 
 
 public:
+    // the largest index that can be set
+    static constexpr size_t max_index = std::numeric_limits<uint32_t>::max();
+
     bitvector_tracking(size_t n) : bitvector_tracking(n, true) {
         memset(data, 0, chunks_count(m_size) * sizeof(uint64_t));
     }
@@ -38,30 +42,40 @@ public:
         memcpy(data, bv.data, chunks_count() * sizeof(uint64_t));
     }
 
-    bitvector_tracking(bitvector_tracking&& bv)
+    bitvector_tracking(bitvector_tracking&& bv) noexcept
         : m_size(bv.m_size)
         , data(bv.data)
+        , owner(bv.owner)
         , non_empty_chunk(bv.non_empty_chunk) {
 
         bv.data = nullptr;
     }
 
     bitvector_tracking& operator=(bitvector_tracking&& bv) {
-        delete[] data;
+        if (owner) {
+            delete[] data;
+        }
 
         m_size  = bv.m_size;
         data    = bv.data;
+        owner   = bv.owner;
         bv.data = nullptr;
 
+        non_empty_chunk = bv.non_empty_chunk;
+
         return *this;
     }
 
     ~bitvector_tracking() {
-        delete[] data;
+        if (owner) {
+            delete[] data;
+        }
     }
 
     void set(size_t index) {
 
+        assert(owner);
+
         const size_t n = index / 64;
         const size_t k = index % 64;
 
@@ -82,31 +96,41 @@ public:
     }
 
     size_t cardinality() const {
-        size_t k = 0;
-        for (size_t i=non_empty_chunk.first; i <= non_empty_chunk.last; i++) {
-            k += __builtin_popcountll(data[i]);
-        }
+        const size_t first = non_empty_chunk.first;
+        const size_t last  = non_empty_chunk.last;
 
-        return k;
+        return bitops_popcount(data + first, last - first + 1);
     }
 
     template <typename CALLBACK>
     void visit(CALLBACK callback) const {
-        for (size_t i=non_empty_chunk.first; i <= non_empty_chunk.last; i++) {
-            uint64_t tmp = data[i];
+        visit_batches([&callback](const uint32_t* ids, size_t n) {
+            for (size_t i=0; i < n; i++) {
+                callback(ids[i]);
+            }
+        });
+    }
 
-            size_t k = i * 64;
-            while (tmp) {
-                if (tmp & 0x1) {
-                    callback(k);
-                }
+    // callback(const uint32_t* ids, size_t n) gets ids in ascending order
+    template <typename CALLBACK>
+    void visit_batches(CALLBACK callback) const {
+        visit_batches_until([&callback](const uint32_t* ids, size_t n) {
+            callback(ids, n);
+            return true;
+        });
+    }
 
-                tmp >>= 1;
-                k += 1;
-            }
-        }
+    // Like visit_batches, but stops as soon as callback returns false.
+    template <typename CALLBACK>
+    void visit_batches_until(CALLBACK callback) const {
+        const size_t first = non_empty_chunk.first;
+        const size_t last  = non_empty_chunk.last;
+
+        bitops_visit_batches_until(data + first, last - first + 1, first * 64, callback);
     }
 
+    void reserve(size_t /*cardinality*/) {}
+
     void update_internal_structures() {
 
         bool set_first = true;
@@ -131,6 +155,51 @@ private:
         : m_size(size)
         , data(new uint64_t[chunks_count()]) {}
 
+    bitvector_tracking(size_t size, const uint64_t* external)
+        : m_size(size)
+        , data(const_cast<uint64_t*>(external))
+        , owner(false) {}
+
+    // Copies the data of a view, thus the bitvector might be modified.
+    void materialize() {
+        if (!owner) {
+            uint64_t* copy = new uint64_t[chunks_count()];
+            memcpy(copy, data, chunks_count() * sizeof(uint64_t));
+            data  = copy;
+            owner = true;
+        }
+    }
+
+public:
+    static constexpr uint32_t file_tag = 2;
+
+    // layout: the first and the last non-empty chunk, then all chunks
+    size_t serialized_size() const {
+        return (2 + chunks_count()) * sizeof(uint64_t);
+    }
+
+    void serialize(char* out) const {
+        const uint64_t range[2] = {non_empty_chunk.first, non_empty_chunk.last};
+        memcpy(out, range, sizeof(range));
+        memcpy(out + sizeof(range), data, chunks_count() * sizeof(uint64_t));
+    }
+
+    // Returns a read-only bitvector that refers to serialized data; the data
+    // has to be 8-byte aligned and must outlive the bitvector.
+    static bitvector_tracking view(size_t size, const char* ptr, size_t bytes) {
+        const uint64_t* words = reinterpret_cast<const uint64_t*>(ptr);
+
+        bitvector_tracking bv(size, words + 2);
+        if (bytes != bv.serialized_size() || words[0] > words[1] || words[1] >= bv.chunks_count()) {
+            throw std::runtime_error("bitvector_tracking: invalid serialized data");
+        }
+
+        bv.non_empty_chunk.first = words[0];
+        bv.non_empty_chunk.last  = words[1];
+
+        return bv;
+    }
+
 public:
     static std::optional<bitvector_tracking> bit_and(const bitvector_tracking& v1, const bitvector_tracking& v2) {
         assert(v1.size() == v2.size());
@@ -143,30 +212,7 @@ public:
         }
 
         bitvector_tracking result(v1.size(), true);
-
-        for (size_t i=0; i < first; i++) {
-            result.data[i] = 0;
-        }
-
-        bool set_first = true;
-        for (size_t i=first; i <= last; i++) {
-            const uint64_t tmp = v1.data[i] & v2.data[i];
-            result.data[i] = tmp;
-            if (tmp != 0) {
-                if (set_first) {
-                    result.non_empty_chunk.first = i;
-                    set_first = false;
-                }
-                result.non_empty_chunk.last = i;
-            }
-        }
-
-        const size_t n = chunks_count(result.m_size);
-        for (size_t i=last + 1; i < n; i++) {
-            result.data[i] = 0;
-        }
-
-        if (set_first) {
+        if (!and_range(result, v1, v2, first, last)) {
             return std::nullopt;
         }
 
@@ -183,29 +229,48 @@ public:
             return false;
         }
 
-        for (size_t i=0; i < first; i++) {
-            v1.data[i] = 0;
+        v1.materialize();
+        return and_range(v1, v1, v2, first, last);
+    }
+
+    static void bit_or_inplace(bitvector_tracking& v1, const bitvector_tracking& v2) {
+        assert(v1.size() == v2.size());
+
+        v1.materialize();
+        for (size_t i=v2.non_empty_chunk.first; i <= v2.non_empty_chunk.last; i++) {
+            v1.data[i] |= v2.data[i];
         }
 
-        bool set_first = true;
-        for (size_t i=first; i <= last; i++) {
-            const uint64_t tmp = v1.data[i] & v2.data[i];
-            v1.data[i] = tmp;
-            if (tmp != 0) {
-                if (set_first) {
-                    v1.non_empty_chunk.first = i;
-                    set_first = false;
-                }
-                v1.non_empty_chunk.last = i;
-            }
+        v1.non_empty_chunk.first = std::min(v1.non_empty_chunk.first, v2.non_empty_chunk.first);
+        v1.non_empty_chunk.last  = std::max(v1.non_empty_chunk.last, v2.non_empty_chunk.last);
+    }
+
+private:
+    // Sets result = v1 & v2 in chunks [first, last], clears the remaining
+    // chunks and narrows the non-empty range. Returns false if result is empty.
+    static bool and_range(bitvector_tracking& result, const bitvector_tracking& v1, const bitvector_tracking& v2,
+                          size_t first, size_t last) {
+
+        const size_t n = result.chunks_count();
+        const size_t count = bitops_and_count(result.data + first, v1.data + first, v2.data + first, last - first + 1);
+
+        memset(result.data, 0, first * sizeof(uint64_t));
+        memset(result.data + last + 1, 0, (n - last - 1) * sizeof(uint64_t));
+        if (count == 0) {
+            return false;
         }
 
-        const size_t n = chunks_count(v1.m_size);
-        for (size_t i=last + 1; i < n; i++) {
-            v1.data[i] = 0;
+        while (result.data[first] == 0) {
+            first += 1;
         }
 
-        return set_first == false;
+        while (result.data[last] == 0) {
+            last -= 1;
+        }
+
+        result.non_empty_chunk.first = first;
+        result.non_empty_chunk.last  = last;
+
+        return true;
     }
 };
-
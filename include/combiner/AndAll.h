@@ -12,7 +12,7 @@ private:
     const bitvector_type* first = nullptr;
 
 public:
-    bool add(const bitvector_type& bv) {
+    bool add(const bitvector_type& bv, size_t /*cardinality*/) {
         if (first == nullptr) {
             first = &bv;
         } else if (!result.has_value()) {
@@ -26,6 +26,10 @@ public:
         return true;
     }
 
+    bool finish() {
+        return has_value();
+    }
+
     bool has_value() const {
         return result.has_value();
     }
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <vector>
+
+// Intersect all incoming bitvectors at once; requires BITVECTOR::bit_and_many.
+template <typename BITVECTOR>
+class AndMany {
+
+public:
+    using bitvector_type = BITVECTOR;
+
+private:
+    std::vector<const bitvector_type*> inputs;
+    std::optional<bitvector_type> result;
+    bool empty = false;
+
+public:
+    bool add(const bitvector_type& bv, size_t cardinality) {
+        if (cardinality == 0) {
+            empty = true;
+            return false;
+        }
+
+        inputs.push_back(&bv);
+        return true;
+    }
+
+    bool finish() {
+        if (empty || inputs.empty()) {
+            return false;
+        }
+
+        // a trigram might repeat in a query
+        std::sort(inputs.begin(), inputs.end());
+        inputs.erase(std::unique(inputs.begin(), inputs.end()), inputs.end());
+
+        result = bitvector_type::bit_and_many(inputs.data(), inputs.size());
+
+        return has_value();
+    }
+
+    bool has_value() const {
+        return result.has_value();
+    }
+
+    const bitvector_type& value() const {
+        return result.value();
+    }
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Costs are expressed in nanoseconds; the defaults are rough measurements
+// from perftest on 200K rows.
+struct CostModel {
+    double and_cost_per_byte = 0.05;    // AND of two bitvectors, per byte of both inputs
+    double verify_cost       = 25.0;    // substring search in a single candidate row
+
+    template <typename BITVECTOR>
+    double and_cost(const BITVECTOR& a, const BITVECTOR& b) const {
+        return and_cost_per_byte * (a.size_in_bytes() + b.size_in_bytes());
+    }
+
+    // Returns true if AND-ing bitvector b, assuming it reduces the number
+    // of candidates from `candidates` to `estimated`, is cheaper than
+    // verifying the eliminated candidates.
+    template <typename BITVECTOR>
+    bool worth_and(const BITVECTOR& a, const BITVECTOR& b, double candidates, double estimated) const {
+        return (candidates - estimated) * verify_cost > and_cost(a, b);
+    }
+};
+
+
+// Intersect bitvectors starting from the one with the smallest cardinality;
+// stop when verification of the remaining candidates is cheaper than the
+// next intersection. The number of candidates after an intersection is
+// estimated assuming that trigrams occur independently.
+template <typename BITVECTOR, typename COST_MODEL = CostModel>
+class CostBased {
+
+public:
+    using bitvector_type = BITVECTOR;
+
+private:
+    COST_MODEL model;
+    std::vector<std::pair<size_t, const bitvector_type*>> inputs;
+    bool empty = false;
+
+    std::optional<bitvector_type> result;
+    const bitvector_type* first = nullptr;
+
+public:
+    CostBased() = default;
+
+    CostBased(const COST_MODEL& model_)
+        : model(model_) {}
+
+    bool add(const bitvector_type& bv, size_t cardinality) {
+        if (cardinality == 0) {
+            empty = true;
+            return false;
+        }
+
+        inputs.emplace_back(cardinality, &bv);
+        return true;
+    }
+
+    bool finish() {
+        if (empty || inputs.empty()) {
+            return false;
+        }
+
+        // a trigram might repeat in a query
+        std::sort(inputs.begin(), inputs.end());
+        inputs.erase(std::unique(inputs.begin(), inputs.end()), inputs.end());
+
+        first = inputs[0].second;
+
+        const double n = first->size();
+        double candidates = inputs[0].first;
+        for (size_t i=1; i < inputs.size(); i++) {
+            const auto& [cardinality, bv] = inputs[i];
+
+            const double estimated = candidates * (cardinality / n);
+            if (!model.worth_and(value(), *bv, candidates, estimated)) {
+                break;
+            }
+
+            if (!result.has_value()) {
+                result = bitvector_type::bit_and(*first, *bv);
+                if (!result.has_value()) {
+                    first = nullptr;
+                    return false;
+                }
+            } else if (!bitvector_type::bit_and_inplace(result.value(), *bv)) {
+                result = std::nullopt;
+                first = nullptr;
+                return false;
+            }
+
+            candidates = estimated;
+        }
+
+        return true;
+    }
+
+    bool has_value() const {
+        return first != nullptr;
+    }
+
+    const bitvector_type& value() const {
+        return result.has_value() ? result.value() : *first;
+    }
+};
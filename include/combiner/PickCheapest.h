@@ -1,7 +1,6 @@
 #pragma once
 
 // Choose the bitmap with the mininum cardinality.
-// It requires a fast cardinality function.
 template <typename BITVECTOR>
 class PickCheapest {
 
@@ -10,24 +9,26 @@ public:
     
 private:
     const bitvector_type* result = nullptr;
-    size_t cardinality;
+    size_t cardinality = 0;
 
 public:
-    bool add(const bitvector_type& bv) {
-
-        const size_t tmp = bv.cardinality();
+    bool add(const bitvector_type& bv, size_t bv_cardinality) {
 
         if (result == nullptr) {
             result = &bv;
-            cardinality = tmp;
-        } else if (tmp < cardinality) {
+            cardinality = bv_cardinality;
+        } else if (bv_cardinality < cardinality) {
             result = &bv;
-            cardinality = tmp;
+            cardinality = bv_cardinality;
         }
 
         return true;
     }
 
+    bool finish() {
+        return has_value();
+    }
+
     bool has_value() const {
         return result != nullptr;
     }
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Keep rows present in at least `threshold` of the incoming bitvectors
+// (the T-occurrence problem), used by approximate search.
+//
+// A row present in T of N lists has to be present in one of the N - T + 1
+// shortest lists. These lists are merged with ScanCount: a counter per
+// row, incremented for each occurrence. The remaining T - 1 longest lists
+// are only probed for the candidates, by intersecting (MergeSkip); after
+// each probe candidates that cannot reach the threshold are dropped.
+// Counters are reused by queries of a thread, see scan_counts.
+template <typename BITVECTOR>
+class TOccurrence {
+
+public:
+    using bitvector_type = BITVECTOR;
+
+private:
+    const size_t threshold;
+    std::vector<std::pair<size_t, const bitvector_type*>> inputs;
+
+    std::optional<bitvector_type> result;
+
+public:
+    TOccurrence(size_t threshold_)
+        : threshold(threshold_) {
+        assert(threshold > 0);
+    }
+
+    bool add(const bitvector_type& bv, size_t cardinality) {
+        if (cardinality > 0) {
+            inputs.emplace_back(cardinality, &bv);
+        }
+
+        return true;
+    }
+
+    bool finish() {
+        if (inputs.size() < threshold) {
+            return false;
+        }
+
+        std::sort(inputs.begin(), inputs.end());
+
+        const size_t rows = inputs[0].second->size();
+        const size_t merged = inputs.size() - threshold + 1;
+
+        // ScanCount
+        std::vector<uint16_t>& counts = scan_counts(rows);
+        std::vector<uint32_t> candidates;
+        for (size_t i=0; i < merged; i++) {
+            inputs[i].second->visit_batches([&counts, &candidates](const uint32_t* ids, size_t n) {
+                for (size_t j=0; j < n; j++) {
+                    if (counts[ids[j]]++ == 0) {
+                        candidates.push_back(ids[j]);
+                    }
+                }
+            });
+        }
+
+        std::sort(candidates.begin(), candidates.end());
+
+        // MergeSkip: `remaining` lists might still add occurrences
+        for (size_t i=merged; i <= inputs.size(); i++) {
+            const size_t remaining = inputs.size() - i;
+            candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](uint32_t id) {
+                if (counts[id] + remaining < threshold) {
+                    counts[id] = 0;
+                    return true;
+                }
+
+                return false;
+            }), candidates.end());
+
+            if (candidates.empty() || remaining == 0) {
+                break;
+            }
+
+            const auto present = bitvector_type::bit_and(make_bitvector(rows, candidates), *inputs[i].second);
+            if (present.has_value()) {
+                present->visit([&counts](uint32_t id) {
+                    counts[id] += 1;
+                });
+            }
+        }
+
+        for (const uint32_t id: candidates) {
+            counts[id] = 0;
+        }
+
+        if (candidates.empty()) {
+            return false;
+        }
+
+        result = make_bitvector(rows, candidates);
+        return true;
+    }
+
+    bool has_value() const {
+        return result.has_value();
+    }
+
+    const bitvector_type& value() const {
+        return result.value();
+    }
+
+private:
+    // A counter per row. Only counters of candidates are set and they are
+    // zeroed again by finish(), thus a query doesn't allocate and clear
+    // a buffer for all rows.
+    static std::vector<uint16_t>& scan_counts(size_t rows) {
+        thread_local std::vector<uint16_t> counts;
+        if (counts.size() < rows) {
+            counts.resize(rows, 0);
+        }
+
+        return counts;
+    }
+
+    // ids have to be sorted
+    static bitvector_type make_bitvector(size_t rows, const std::vector<uint32_t>& ids) {
+        bitvector_type bv(rows);
+        bv.reserve(ids.size());
+        for (const uint32_t id: ids) {
+            bv.set(id);
+        }
+
+        bv.update_internal_structures();
+        return bv;
+    }
+};
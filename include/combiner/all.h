@@ -2,4 +2,7 @@
 
 #include "AndAll.h"
 #include "PickCheapest.h"
+#include "CostBased.h"
+#include "AndMany.h"
+#include "TOccurrence.h"
 
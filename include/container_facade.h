@@ -1,6 +1,35 @@
 #pragma once
 
 #include <algorithm>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__)
+#   include <immintrin.h>
+#endif
+
+
+// Read-only range of sorted indices
+struct index_range {
+    const uint32_t* first;
+    const uint32_t* last;
+
+    const uint32_t* begin() const {
+        return first;
+    }
+
+    const uint32_t* end() const {
+        return last;
+    }
+
+    size_t size() const {
+        return last - first;
+    }
+};
 
 
 template <typename CONTAINER, typename INSERTER>
@@ -48,26 +77,178 @@ void intersect(const CONTAINER& a, const CONTAINER& b, INSERTER output)
 }
 
 
-template <template<typename> class CONTAINER, bool append = true, bool has_size = true, bool has_resize = true>
+// In-place intersection kernels: keep values of out[0 .. n) present in
+// the sorted list b, return the new n. The values must be sorted.
+
+// Exponential search for each value; good when b is much longer than out.
+inline size_t intersect_inplace_galloping(uint32_t* out, size_t n, index_range b) {
+    size_t k = 0;
+    const uint32_t* it = b.first;
+    for (size_t i=0; i < n; i++) {
+        const uint32_t x = out[i];
+
+        const size_t remaining = b.last - it;
+        size_t bound = 1;
+        while (bound <= remaining && it[bound - 1] < x) {
+            bound *= 2;
+        }
+
+        // it[bound/2 - 1] < x <= it[bound - 1]
+        it = std::lower_bound(it + bound / 2, it + std::min(bound, remaining), x);
+        if (it == b.last) {
+            break;
+        }
+
+        if (*it == x) {
+            out[k++] = x;
+        }
+    }
+
+    return k;
+}
+
+
+inline size_t intersect_inplace_scalar(uint32_t* out, size_t n, index_range b) {
+    size_t k = 0;
+    const uint32_t* it = b.first;
+    for (size_t i=0; i < n; i++) {
+        const uint32_t x = out[i];
+        while (it < b.last && *it < x) {
+            it += 1;
+        }
+
+        if (it == b.last) {
+            break;
+        }
+
+        if (*it == x) {
+            out[k++] = x;
+        }
+    }
+
+    return k;
+}
+
+
+#if defined(__x86_64__)
+
+// Blocks of b are skipped by comparing their last value, then a value
+// is compared with the whole block at once.
+__attribute__((target("avx2")))
+inline size_t intersect_inplace_avx2(uint32_t* out, size_t n, index_range b) {
+    size_t k = 0;
+    const uint32_t* it = b.first;
+    for (size_t i=0; i < n; i++) {
+        const uint32_t x = out[i];
+        while (it + 8 <= b.last && it[7] < x) {
+            it += 8;
+        }
+
+        if (it + 8 > b.last) {
+            // fewer than 8 values left; results are moved down to out[k]
+            const size_t tail = intersect_inplace_scalar(out + i, n - i, {it, b.last});
+            std::copy(out + i, out + i + tail, out + k);
+            return k + tail;
+        }
+
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(it));
+        const __m256i eq = _mm256_cmpeq_epi32(block, _mm256_set1_epi32(x));
+        out[k] = x;
+        k += !_mm256_testz_si256(eq, eq);
+    }
+
+    return k;
+}
+
+#endif // defined(__x86_64__)
+
+
+using intersect_inplace_fn = size_t (*)(uint32_t* out, size_t n, index_range b);
+
+inline intersect_inplace_fn intersect_inplace_block() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return intersect_inplace_avx2;
+    }
+#endif
+    return intersect_inplace_scalar;
+}
+
+
+// Intersects k sorted lists in one pass. The shortest list is copied to out,
+// which then is intersected in-place with remaining lists; out has to be
+// able to hold the shortest list. Returns the number of common values.
+inline size_t intersect_many(const index_range* lists, size_t k, uint32_t* out) {
+    static const intersect_inplace_fn block = intersect_inplace_block();
+
+    if (k == 0) {
+        return 0;
+    }
+
+    const index_range* shortest = std::min_element(lists, lists + k, [](const index_range& a, const index_range& b) {
+        return a.size() < b.size();
+    });
+
+    size_t n = shortest->size();
+    std::copy(shortest->begin(), shortest->end(), out);
+    for (size_t i=0; i < k && n > 0; i++) {
+        if (lists + i == shortest) {
+            continue;
+        }
+
+        if (lists[i].size() / 32 > n) {
+            n = intersect_inplace_galloping(out, n, lists[i]);
+        } else {
+            n = block(out, n, lists[i]);
+        }
+    }
+
+    return n;
+}
+
+
+// VALUE is the type of stored indices; a narrower type might be used when
+// all indices are known to be small, see ShardedDB.
+template <template<typename> class CONTAINER, bool append = true, bool has_size = true, bool has_resize = true, typename VALUE = uint32_t>
 class container_facade {
 
 public:
-    static constexpr bool custom_filter = false;
+    static constexpr bool contiguous = std::is_same_v<CONTAINER<VALUE>, std::vector<uint32_t>>;
 
 private:
-    CONTAINER<uint32_t> indices;
+    CONTAINER<VALUE> indices;
     size_t m_size;
     ssize_t last_set = -1;
 
+    // a contiguous container might refer to external memory, see view()
+    const uint32_t* view_data = nullptr;
+    size_t view_size = 0;
+
 public:
+    // the largest index that can be set
+    static constexpr size_t max_index = std::numeric_limits<VALUE>::max();
+
     container_facade(size_t n) : m_size(n) {}
 
+    // Sorted indices of a contiguous container.
+    index_range range() const {
+        static_assert(contiguous);
+        if (view_data != nullptr) {
+            return {view_data, view_data + view_size};
+        }
+
+        return {indices.data(), indices.data() + indices.size()};
+    }
+
     void set(size_t index) {
+        assert(view_data == nullptr);
         if (ssize_t(index) == last_set) {
             return;
         }
 
         assert(ssize_t(index) > last_set);
+        assert(index <= std::numeric_limits<VALUE>::max());
         last_set = index;
         if constexpr (append)
             indices.push_back(index);
@@ -75,10 +256,18 @@ public:
             indices.push_front(index);
     }
 
+    void reserve(size_t cardinality) {
+        if constexpr (has_resize) {
+            indices.reserve(cardinality);
+        }
+    }
+
     void update_internal_structures() {}
 
     size_t cardinality() const {
-        if constexpr (!has_size) {
+        if constexpr (contiguous) {
+            return range().size();
+        } else if constexpr (!has_size) {
             size_t n = 0;
             auto first = indices.begin();
             auto last  = indices.end();
@@ -100,16 +289,84 @@ public:
         size_t total = 0;
 
         total += sizeof(indices);
-        total += cardinality() * sizeof(uint32_t);
+        total += cardinality() * sizeof(VALUE);
 
         return total;
     }
 
     template <typename CALLBACK>
     void visit(CALLBACK callback) const {
-        for (auto index: indices) {
-            callback(index);
+        visit_batches([&callback](const uint32_t* ids, size_t n) {
+            for (size_t i=0; i < n; i++) {
+                callback(ids[i]);
+            }
+        });
+    }
+
+    // callback(const uint32_t* ids, size_t n) gets ids in the container's order
+    template <typename CALLBACK>
+    void visit_batches(CALLBACK callback) const {
+        visit_batches_until([&callback](const uint32_t* ids, size_t n) {
+            callback(ids, n);
+            return true;
+        });
+    }
+
+    // Like visit_batches, but stops as soon as callback returns false.
+    template <typename CALLBACK>
+    void visit_batches_until(CALLBACK callback) const {
+        if constexpr (contiguous) {
+            const auto r = range();
+            if (r.size() > 0) {
+                callback(r.first, r.size());
+            }
+        } else {
+            uint32_t buffer[256];
+            size_t n = 0;
+            for (auto index: indices) {
+                buffer[n++] = index;
+                if (n == std::size(buffer)) {
+                    if (!callback(static_cast<const uint32_t*>(buffer), n)) {
+                        return;
+                    }
+                    n = 0;
+                }
+            }
+
+            if (n > 0) {
+                callback(static_cast<const uint32_t*>(buffer), n);
+            }
+        }
+    }
+
+public:
+    static constexpr uint32_t file_tag = 3;
+
+    size_t serialized_size() const {
+        return range().size() * sizeof(uint32_t);
+    }
+
+    void serialize(char* out) const {
+        const auto r = range();
+        memcpy(out, r.first, r.size() * sizeof(uint32_t));
+    }
+
+    // Returns a read-only facade that refers to serialized data; the data
+    // has to be 4-byte aligned and must outlive the facade.
+    static container_facade view(size_t size, const char* ptr, size_t bytes) {
+        static_assert(contiguous);
+        if (bytes % sizeof(uint32_t) != 0) {
+            throw std::runtime_error("container_facade: invalid serialized size");
+        }
+
+        container_facade result(size);
+        result.view_data = reinterpret_cast<const uint32_t*>(ptr);
+        result.view_size = bytes / sizeof(uint32_t);
+        if (result.view_size > 0) {
+            result.last_set = result.view_data[result.view_size - 1];
         }
+
+        return result;
     }
 
 public:
@@ -120,13 +377,89 @@ public:
 
     static bool bit_and_inplace(container_facade& v1, const container_facade& v2) {
         
-        auto tmp = bit_and_aux(v1, v2);
-        v1.indices = std::move(tmp.indices);
+        // v1 might be a view, the result is always owned
+        v1 = bit_and_aux(v1, v2);
 
         return v1.cardinality() > 0;
     }
 
+    static void bit_or_inplace(container_facade& v1, const container_facade& v2) {
+        assert(v1.size() == v2.size());
+
+        if (v2.last_set < 0) {
+            return;
+        }
+
+        if constexpr (contiguous) {
+            v1.materialize();
+            bit_or_aux(v1, v2.range(), v2.last_set);
+        } else {
+            bit_or_aux(v1, v2.indices, v2.last_set);
+        }
+    }
+
+    // Intersects all inputs at once, see intersect_many.
+    static std::optional<container_facade> bit_and_many(const container_facade* const* inputs, size_t k) {
+        static_assert(contiguous);
+        assert(k > 0);
+
+        std::vector<index_range> lists(k);
+        size_t shortest = inputs[0]->cardinality();
+        for (size_t i=0; i < k; i++) {
+            assert(inputs[i]->size() == inputs[0]->size());
+            lists[i] = inputs[i]->range();
+            shortest = std::min(shortest, lists[i].size());
+        }
+
+        container_facade result(inputs[0]->size());
+        result.indices.resize(shortest);
+        result.indices.resize(intersect_many(lists.data(), k, result.indices.data()));
+        if (result.indices.empty()) {
+            return std::nullopt;
+        }
+
+        result.last_set = result.indices.back();
+
+        return result;
+    }
+
 private:
+    // Copies the data of a view, thus the facade might be modified.
+    void materialize() {
+        if (view_data != nullptr) {
+            indices.assign(view_data, view_data + view_size);
+            view_data = nullptr;
+            view_size = 0;
+        }
+    }
+
+    template <typename SOURCE>
+    static void bit_or_aux(container_facade& v1, const SOURCE& v2, ssize_t v2_last_set) {
+        if constexpr (append) {
+            if (v1.last_set < ssize_t(*v2.begin())) {
+                // a common case when partial indexes are merged: all rows of v2 follow v1
+                v1.indices.insert(v1.indices.end(), v2.begin(), v2.end());
+                v1.last_set = v2_last_set;
+                return;
+            }
+        }
+
+        std::vector<VALUE> tmp;
+        if constexpr (append) {
+            std::set_union(v1.indices.begin(), v1.indices.end(),
+                           v2.begin(), v2.end(),
+                           std::back_inserter(tmp));
+        } else {
+            // indices are kept in the descending order
+            std::set_union(v1.indices.begin(), v1.indices.end(),
+                           v2.begin(), v2.end(),
+                           std::back_inserter(tmp), std::greater<VALUE>());
+        }
+
+        v1.indices.assign(tmp.begin(), tmp.end());
+        v1.last_set = std::max(v1.last_set, v2_last_set);
+    }
+
     static container_facade bit_and_aux(const container_facade& v1, const container_facade& v2) {
         assert(v1.size() == v2.size());
         
@@ -142,7 +475,9 @@ private:
                 return std::front_inserter(result.indices);
         };
 
-        if constexpr (has_size) {
+        if constexpr (contiguous) {
+            intersect(v1.range(), v2.range(), get_inserter());
+        } else if constexpr (has_size) {
             intersect(v1.indices, v2.indices, get_inserter());
         } else {
             std::set_intersection(v1.indices.begin(), v1.indices.end(),
@@ -150,6 +485,13 @@ private:
                                   get_inserter());
         }
 
+        if (!result.indices.empty()) {
+            if constexpr (append)
+                result.last_set = result.indices.back();
+            else
+                result.last_set = result.indices.front();
+        }
+
         return result;
     }
 };
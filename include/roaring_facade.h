@@ -2,33 +2,11 @@
 
 #include <roaring.hh>
 
+#include <iterator>
 #include <memory>
 #include <optional>
 #include <limits>
-
-struct roaring_facade_filter_data final {
-    const Collection& rows;
-    const std::string& word;
-    size_t count;
-
-    roaring_facade_filter_data(const Collection& rows_, const std::string& word_)
-        : rows(rows_)
-        , word(word_)
-        , count(0) {}
-
-    void update(size_t index) {
-        if (rows[index].find(word) != std::string::npos) {
-            count += 1;
-        }
-    }
-};
-
-bool roaring_facade_filter(uint32_t index, void* ptr) {
-    auto& data = *reinterpret_cast<roaring_facade_filter_data*>(ptr);
-    data.update(index);
-
-    return true;
-}
+#include <stdexcept>
 
 class roaring_facade final {
 
@@ -37,6 +15,9 @@ private:
     size_t m_size;
 
 public:
+    // the largest index that can be set
+    static constexpr size_t max_index = std::numeric_limits<uint32_t>::max() - 1;
+
     roaring_facade(size_t n) : m_size(n) {}
 
     void set(size_t index) {
@@ -44,6 +25,8 @@ public:
         roaring.add(index);
     }
 
+    void reserve(size_t /*cardinality*/) {}
+
     void update_internal_structures() {}
 
     size_t cardinality() const {
@@ -59,21 +42,63 @@ public:
     }
 
     template <typename CALLBACK>
-    void visit(CALLBACK /*callback*/) const {
-        // I don't know how to call a template-defined callable
-        // inside a C function.
-        // this works:   roaring.iterate([](uint32_t, void*){return true;}, nullptr);
-        // this doesn't: roaring.iterate([&callback](uint32_t, void*){return true;}, nullptr);
+    void visit(CALLBACK callback) const {
+        visit_batches([&callback](const uint32_t* ids, size_t n) {
+            for (size_t i=0; i < n; i++) {
+                callback(ids[i]);
+            }
+        });
+    }
+
+    // callback(const uint32_t* ids, size_t n) gets ids in ascending order
+    template <typename CALLBACK>
+    void visit_batches(CALLBACK callback) const {
+        visit_batches_until([&callback](const uint32_t* ids, size_t n) {
+            callback(ids, n);
+            return true;
+        });
+    }
+
+    // Like visit_batches, but stops as soon as callback returns false.
+    template <typename CALLBACK>
+    void visit_batches_until(CALLBACK callback) const {
+        uint32_t buffer[256];
+
+        // CRoaring 2.x names, roaring_init_iterator and
+        // roaring_read_uint32_iterator are deprecated
+        roaring_uint32_iterator_t it;
+        roaring_iterator_init(&roaring.roaring, &it);
+        while (true) {
+            const uint32_t n = roaring_uint32_iterator_read(&it, buffer, std::size(buffer));
+            if (n == 0 || !callback(static_cast<const uint32_t*>(buffer), size_t(n))) {
+                break;
+            }
+        }
     }
 
 public:
-    static constexpr bool custom_filter = true;
+    static constexpr uint32_t file_tag = 4;
+
+    // roaring's portable format
+    size_t serialized_size() const {
+        return roaring.getSizeInBytes(true);
+    }
+
+    void serialize(char* out) const {
+        roaring.write(out, true);
+    }
 
-    size_t filter_out_false_positives(const Collection& rows, const std::string& word) const {
-        roaring_facade_filter_data d(rows, word);
-        roaring.iterate(roaring_facade_filter, &d);
+    // Unlike other types, the portable format has to be deserialized,
+    // thus the data is copied. Reading is bounded by `bytes`, invalid
+    // data throws std::runtime_error.
+    static roaring_facade view(size_t size, const char* ptr, size_t bytes) {
+        roaring_facade result(size);
+        result.roaring = Roaring::readSafe(ptr, bytes);
+        if (result.roaring.getSizeInBytes(true) != bytes) {
+            throw std::runtime_error("roaring_facade: invalid serialized size");
+        }
 
-        return d.count;
+        return result;
     }
 
 public:
@@ -95,4 +120,11 @@ public:
 
         return !v1.roaring.isEmpty();
     }
+
+    static void bit_or_inplace(roaring_facade& v1, const roaring_facade& v2) {
+
+        assert(v1.size() == v2.size());
+
+        v1.roaring |= v2.roaring;
+    }
 };
@@ -0,0 +1,328 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__x86_64__)
+#   include <immintrin.h>
+#endif
+
+// Substring search kernels. All return position of the first occurrence
+// of needle in s, or std::string_view::npos.
+//
+// SIMD variants compare the first and the last character of needle with
+// all positions of a chunk at once; only positions matching both characters
+// are verified with memcmp.
+
+using substring_find_fn = size_t (*)(const char* s, size_t n, const char* needle, size_t k);
+
+
+inline size_t substring_find_scalar(const char* s, size_t n, const char* needle, size_t k) {
+    if (k == 0) {
+        return 0;
+    }
+
+    if (k > n) {
+        return std::string_view::npos;
+    }
+
+    const char* first = s;
+    const char* last  = s + n - k + 1;
+    while (first < last) {
+        first = static_cast<const char*>(memchr(first, needle[0], last - first));
+        if (first == nullptr) {
+            break;
+        }
+
+        if (memcmp(first + 1, needle + 1, k - 1) == 0) {
+            return first - s;
+        }
+
+        first += 1;
+    }
+
+    return std::string_view::npos;
+}
+
+
+#if defined(__x86_64__)
+
+// SSE2 is a part of x86-64, no runtime check needed
+inline size_t substring_find_sse(const char* s, size_t n, const char* needle, size_t k) {
+    if (k < 2 || k > n) {
+        return substring_find_scalar(s, n, needle, k);
+    }
+
+    // positions 0 .. n - k are checked
+    const size_t positions = n - k + 1;
+    if (positions < 16) {
+        return substring_find_scalar(s, n, needle, k);
+    }
+
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last  = _mm_set1_epi8(needle[k - 1]);
+
+    auto check = [&](size_t i, uint32_t skip) -> size_t {
+        const __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        const __m128i block_last  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + k - 1));
+
+        const __m128i eq_first = _mm_cmpeq_epi8(first, block_first);
+        const __m128i eq_last  = _mm_cmpeq_epi8(last, block_last);
+
+        uint32_t mask = _mm_movemask_epi8(_mm_and_si128(eq_first, eq_last)) & ~skip;
+        while (mask != 0) {
+            const size_t pos = __builtin_ctz(mask);
+            if (memcmp(s + i + pos + 1, needle + 1, k - 2) == 0) {
+                return i + pos;
+            }
+
+            mask &= mask - 1;
+        }
+
+        return std::string_view::npos;
+    };
+
+    size_t i = 0;
+    for (/**/; i + 16 <= positions; i += 16) {
+        const size_t pos = check(i, 0);
+        if (pos != std::string_view::npos) {
+            return pos;
+        }
+    }
+
+    if (i < positions) {
+        // the last chunk overlaps already checked positions
+        const size_t tail = positions - 16;
+        return check(tail, (uint32_t(1) << (i - tail)) - 1);
+    }
+
+    return std::string_view::npos;
+}
+
+
+__attribute__((target("avx2")))
+inline size_t substring_find_avx2(const char* s, size_t n, const char* needle, size_t k) {
+    if (k < 2 || k > n) {
+        return substring_find_scalar(s, n, needle, k);
+    }
+
+    // positions 0 .. n - k are checked
+    const size_t positions = n - k + 1;
+    if (positions < 32) {
+        // rows are usually short, so this case is common
+        return substring_find_sse(s, n, needle, k);
+    }
+
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last  = _mm256_set1_epi8(needle[k - 1]);
+
+    auto check = [&](size_t i, uint32_t skip) __attribute__((target("avx2"))) -> size_t {
+        const __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        const __m256i block_last  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + k - 1));
+
+        const __m256i eq_first = _mm256_cmpeq_epi8(first, block_first);
+        const __m256i eq_last  = _mm256_cmpeq_epi8(last, block_last);
+
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(eq_first, eq_last)) & ~skip;
+        while (mask != 0) {
+            const size_t pos = __builtin_ctz(mask);
+            if (memcmp(s + i + pos + 1, needle + 1, k - 2) == 0) {
+                return i + pos;
+            }
+
+            mask &= mask - 1;
+        }
+
+        return std::string_view::npos;
+    };
+
+    size_t i = 0;
+    for (/**/; i + 32 <= positions; i += 32) {
+        const size_t pos = check(i, 0);
+        if (pos != std::string_view::npos) {
+            return pos;
+        }
+    }
+
+    if (i < positions) {
+        // the last chunk overlaps already checked positions
+        const size_t tail = positions - 32;
+        return check(tail, (uint32_t(1) << (i - tail)) - 1);
+    }
+
+    return std::string_view::npos;
+}
+
+
+__attribute__((target("avx512f,avx512bw")))
+inline size_t substring_find_avx512bw(const char* s, size_t n, const char* needle, size_t k) {
+    if (k < 2 || k > n) {
+        return substring_find_scalar(s, n, needle, k);
+    }
+
+    const __m512i first = _mm512_set1_epi8(needle[0]);
+    const __m512i last  = _mm512_set1_epi8(needle[k - 1]);
+
+    // positions 0 .. n - k are checked; masked loads never touch bytes past the end
+    const size_t positions = n - k + 1;
+    for (size_t i=0; i < positions; i += 64) {
+        const size_t count = std::min(positions - i, size_t(64));
+        const __mmask64 valid = (count == 64) ? ~__mmask64(0) : (__mmask64(1) << count) - 1;
+
+        const __m512i block_first = _mm512_maskz_loadu_epi8(valid, s + i);
+        const __m512i block_last  = _mm512_maskz_loadu_epi8(valid, s + i + k - 1);
+
+        const __mmask64 eq_first = _mm512_mask_cmpeq_epi8_mask(valid, first, block_first);
+        uint64_t mask = _mm512_mask_cmpeq_epi8_mask(eq_first, last, block_last);
+        while (mask != 0) {
+            const size_t pos = __builtin_ctzll(mask);
+            if (memcmp(s + i + pos + 1, needle + 1, k - 2) == 0) {
+                return i + pos;
+            }
+
+            mask &= mask - 1;
+        }
+    }
+
+    return std::string_view::npos;
+}
+
+#endif // defined(__x86_64__)
+
+
+struct substring_kernel {
+    const char* name;
+    substring_find_fn find;
+};
+
+// Returns all kernels supported by the CPU, the best one is the last.
+inline std::vector<substring_kernel> substring_kernels() {
+    std::vector<substring_kernel> kernels;
+    kernels.push_back({"scalar", substring_find_scalar});
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    kernels.push_back({"SSE", substring_find_sse});
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back({"AVX2", substring_find_avx2});
+    }
+    if (__builtin_cpu_supports("avx512bw")) {
+        kernels.push_back({"AVX512BW", substring_find_avx512bw});
+    }
+#endif
+
+    return kernels;
+}
+
+
+inline size_t substring_find(std::string_view s, std::string_view needle) {
+    static const substring_find_fn find = substring_kernels().back().find;
+
+    return find(s.data(), s.size(), needle.data(), needle.size());
+}
+
+
+inline bool substring_contains(std::string_view s, std::string_view needle) {
+    return substring_find(s, needle) != std::string_view::npos;
+}
+
+
+
+// Approximate search: finds a substring within edit distance k (insertions,
+// deletions and substitutions) of needle.
+//
+// The bit-parallel algorithm of Myers computes a column of the dynamic
+// programming matrix in a few word operations; it is used for needles of
+// up to 64 characters, longer ones fall back to the plain matrix (Sellers).
+// The needle is preprocessed once, see substring_contains_approximate.
+class approximate_matcher {
+    std::string needle;
+    size_t k;
+    uint64_t peq[256] = {0};    // peq[c] has i-th bit set if needle[i] == c
+
+public:
+    approximate_matcher(std::string_view needle_, size_t k_)
+        : needle(needle_)
+        , k(k_) {
+
+        if (needle.size() <= 64) {
+            for (size_t i=0; i < needle.size(); i++) {
+                peq[uint8_t(needle[i])] |= uint64_t(1) << i;
+            }
+        }
+    }
+
+    bool operator()(std::string_view s) const {
+        const size_t m = needle.size();
+        if (m <= k) {
+            return true;
+        }
+
+        return (m <= 64) ? bit_parallel(s) : dynamic_programming(s);
+    }
+
+private:
+    bool bit_parallel(std::string_view s) const {
+        const uint64_t last = uint64_t(1) << (needle.size() - 1);
+        uint64_t pv = ~uint64_t(0);
+        uint64_t mv = 0;
+        size_t score = needle.size();
+        for (const char c: s) {
+            const uint64_t eq = peq[uint8_t(c)];
+            const uint64_t xv = eq | mv;
+            const uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+
+            uint64_t ph = mv | ~(xh | pv);
+            uint64_t mh = pv & xh;
+            if (ph & last) {
+                score += 1;
+            } else if (mh & last) {
+                score -= 1;
+            }
+
+            // a match might start anywhere, thus the first row stays zero
+            ph <<= 1;
+            mh <<= 1;
+            pv = mh | ~(xv | ph);
+            mv = ph & xv;
+
+            if (score <= k) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool dynamic_programming(std::string_view s) const {
+        const size_t m = needle.size();
+        std::vector<size_t> column(m + 1);
+        for (size_t i=0; i <= m; i++) {
+            column[i] = i;
+        }
+
+        for (const char c: s) {
+            size_t diagonal = 0; // the first row stays zero
+            for (size_t i=1; i <= m; i++) {
+                const size_t value = std::min({column[i] + 1, column[i - 1] + 1, diagonal + (needle[i - 1] != c)});
+                diagonal = column[i];
+                column[i] = value;
+            }
+
+            if (column[m] <= k) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+};
+
+
+inline bool substring_contains_approximate(std::string_view s, std::string_view needle, size_t k) {
+    return approximate_matcher(needle, k)(s);
+}
@@ -1,6 +1,119 @@
 #pragma once
 
-#include <deque>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
 
-using Collection = std::deque<std::string>;
+// Rows can't contain such a string, see Collection.
+inline bool has_null_character(std::string_view s) {
+    return s.find('\0') != std::string_view::npos;
+}
 
+
+// Rows are stored one after another in a single buffer, each row is
+// followed by the null character, so it might be used as a C-string.
+//
+// Rows never contain the null character. Indexes rely on it: short keys
+// and 4-gram keys have a null byte, thus they never collide with trigrams
+// of rows (see Index::short_key and Index::ngram_key). A query with the
+// null character matches no row, its keys must not be taken as exact.
+class Collection {
+
+    std::vector<char> data;
+    std::vector<uint32_t> offsets{0}; // i-th row spans [offsets[i], offsets[i + 1] - 1)
+
+public:
+    class const_iterator {
+        const Collection* collection;
+        size_t index;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = std::string_view;
+        using difference_type   = ptrdiff_t;
+        using pointer           = const std::string_view*;
+        using reference         = std::string_view;
+
+        const_iterator(const Collection* collection_, size_t index_)
+            : collection(collection_)
+            , index(index_) {}
+
+        std::string_view operator*() const {
+            return (*collection)[index];
+        }
+
+        const_iterator& operator++() {
+            index += 1;
+            return *this;
+        }
+
+        bool operator==(const const_iterator& it) const {
+            return index == it.index;
+        }
+
+        bool operator!=(const const_iterator& it) const {
+            return index != it.index;
+        }
+    };
+
+public:
+    size_t size() const {
+        return offsets.size() - 1;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    std::string_view operator[](size_t index) const {
+        return {data.data() + offsets[index], offsets[index + 1] - offsets[index] - 1};
+    }
+
+    const char* c_str(size_t index) const {
+        return data.data() + offsets[index];
+    }
+
+    const_iterator begin() const {
+        return {this, 0};
+    }
+
+    const_iterator end() const {
+        return {this, size()};
+    }
+
+    void emplace_back(std::string_view row) {
+        if (has_null_character(row)) {
+            throw std::invalid_argument("Collection: a row contains the null character");
+        }
+
+        if (data.size() + row.size() + 1 > UINT32_MAX) {
+            throw std::length_error("Collection: too much data");
+        }
+
+        data.insert(data.end(), row.begin(), row.end());
+        data.push_back('\0');
+        offsets.push_back(data.size());
+    }
+
+    void reserve(size_t rows, size_t bytes) {
+        offsets.reserve(rows + 1);
+        data.reserve(bytes);
+    }
+
+    void shrink_to_fit() {
+        offsets.shrink_to_fit();
+        data.shrink_to_fit();
+    }
+
+    size_t size_in_bytes() const {
+        size_t total = 0;
+
+        total += sizeof(*this);
+        total += data.capacity();
+        total += offsets.capacity() * sizeof(uint32_t);
+
+        return total;
+    }
+};
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <vector>
+#include "container_facade.h"
+
+// Sorted vector of 16-bit indices, suitable for segments of up to 64K rows.
+using vector16_facade = container_facade<std::vector, true, true, true, uint16_t>;
@@ -4,6 +4,7 @@
 #include <limits>
 #include <chrono>
 #include <fstream>
+#include <thread>
 
 #include <cassert>
 #include <cstring>
@@ -15,15 +16,28 @@
 #endif
 
 #include "Builder.h"
+#include "BulkBuilder.h"
+#include "IndexFile.h"
+#include "substring.h"
+#include "bitops.h"
+#include "ThreadPool.h"
 #include "DB.h"
 #include "NaiveDB.h"
 #include "IndexedDB.h"
+#include "ShardedDB.h"
+#include "LiveDB.h"
+#include "CachedDB.h"
+#include "PositionalDB.h"
+#include "Pattern.h"
 #include "combiner/all.h"
 
 #include "bitvector_tracking.h"
 #include "bitvector_naive.h"
 #include "bitvector_sparse.h"
+#include "bitvector_compressed.h"
+#include "bitvector_hybrid.h"
 #include "vector_facade.h"
+#include "vector16_facade.h"
 #include "deque_facade.h"
 #include "list_facade.h"
 #ifdef ROARING
@@ -47,16 +61,19 @@ Collection load(const char* path) {
     f.exceptions(std::ifstream::badbit);
     f.open(path);
 
+    std::string str;
     while (!f.eof()) {
-        std::string str;
         std::getline(f, str);
         if (!str.empty()) {
-            coll.emplace_back(std::move(str));
+            coll.emplace_back(str);
         }
     }
 
+    coll.shrink_to_fit();
+
     const auto t2 = Clock::now();
-    printf("%lu rows, %lu ms\n", coll.size(), elapsed(t1, t2));
+    const double MiBs = coll.size_in_bytes() / double(1024 * 1024);
+    printf("%lu rows (%0.3f MiB), %lu ms\n", coll.size(), MiBs, elapsed(t1, t2));
 
     return coll;
 }
@@ -80,10 +97,223 @@ void test_performance(const DB& db, const Collection& words, int repeat_count) {
 }
 
 
+void test_batch_performance(const DB& db, const Collection& words, int repeat_count) {
+
+    constexpr size_t batch_size = 256;
+
+    std::vector<std::string_view> queries(words.begin(), words.end());
+    std::vector<int> results(queries.size());
+
+    printf("\tsearching in batches of %lu (%d times)... ", batch_size, repeat_count); fflush(stdout);
+    volatile int k = repeat_count;
+    int result = 0;
+    Clock::rep best_time = std::numeric_limits<Clock::rep>::max();
+    while (k--) {
+        const auto t1 = Clock::now();
+        for (size_t i=0; i < queries.size(); i += batch_size) {
+            const size_t n = std::min(batch_size, queries.size() - i);
+            db.matches_batch(queries.data() + i, n, results.data() + i);
+        }
+        const auto t2 = Clock::now();
+        best_time = std::min(best_time, elapsed(t1, t2));
+
+        for (const int r: results) {
+            result += r;
+        }
+    }
+
+    printf("%d match(es), %lu ms\n", result, best_time);
+}
+
+
+// Queries are 1- and 2-character prefixes of words.
+void test_short_performance(const DB& db, const Collection& words, int repeat_count) {
+
+    std::vector<std::string_view> queries;
+    for (const auto word: words) {
+        for (size_t n=1; n <= std::min(size_t(2), word.size()); n++) {
+            queries.push_back(word.substr(0, n));
+        }
+    }
+
+    printf("\tsearching %lu short queries (%d times)... ", queries.size(), repeat_count); fflush(stdout);
+    volatile int k = repeat_count;
+    int result = 0;
+    Clock::rep best_time = std::numeric_limits<Clock::rep>::max();
+    while (k--) {
+        const auto t1 = Clock::now();
+        for (const auto& word: queries) {
+            result += db.matches(word);
+        }
+        const auto t2 = Clock::now();
+        best_time = std::min(best_time, elapsed(t1, t2));
+    }
+
+    printf("%d match(es), %lu ms\n", result, best_time);
+}
+
+
+// Fetches a page of matching rows for each query.
+void test_limit_performance(const DB& db, const Collection& words, int repeat_count) {
+
+    constexpr size_t limit = 20;
+
+    printf("\tfetching up to %lu rows (%d times)... ", limit, repeat_count); fflush(stdout);
+    volatile int k = repeat_count;
+    size_t result = 0;
+    Clock::rep best_time = std::numeric_limits<Clock::rep>::max();
+    while (k--) {
+        const auto t1 = Clock::now();
+        for (const auto& word: words) {
+            result += db.visit_matches(word, limit, [](size_t) { return true; });
+        }
+        const auto t2 = Clock::now();
+        best_time = std::min(best_time, elapsed(t1, t2));
+    }
+
+    printf("%lu row(s), %lu ms\n", result, best_time);
+}
+
+
+// Boolean queries made of pairs of consecutive words.
+void test_query_performance(const DB& db, const Collection& words, int repeat_count) {
+
+    std::vector<Query> queries;
+    for (size_t i=0; i + 1 < words.size(); i += 2) {
+        const Query a = Query::term(words[i]);
+        const Query b = Query::term(words[i + 1]);
+        queries.push_back(a || b);
+        queries.push_back(a && !b);
+    }
+
+    printf("\tsearching %lu boolean queries (%d times)... ", queries.size(), repeat_count); fflush(stdout);
+    volatile int k = repeat_count;
+    int result = 0;
+    Clock::rep best_time = std::numeric_limits<Clock::rep>::max();
+    while (k--) {
+        const auto t1 = Clock::now();
+        for (const auto& query: queries) {
+            result += db.count(query);
+        }
+        const auto t2 = Clock::now();
+        best_time = std::min(best_time, elapsed(t1, t2));
+    }
+
+    printf("%d match(es), %lu ms\n", result, best_time);
+}
+
+
+// LIKE patterns and regular expressions made of pairs of words of at least 3 characters.
+void test_pattern_performance(const DB& db, const Collection& words, int repeat_count) {
+
+    constexpr size_t max_queries = 1000;
+
+    std::vector<std::string_view> long_words;
+    for (const auto word: words) {
+        if (word.size() >= 3) {
+            long_words.push_back(word);
+        }
+    }
+
+    std::vector<Query> queries;
+    for (size_t i=0; i + 1 < long_words.size() && queries.size() < max_queries; i += 2) {
+        const std::string a(long_words[i]);
+        const std::string b(long_words[i + 1]);
+        queries.push_back(like_query("%" + a + "%" + b + "%"));
+        try {
+            queries.push_back(regex_query(a + "|" + b + ".*a"));
+        } catch (const std::regex_error&) {
+            // a word is not a valid regular expression
+        }
+    }
+
+    printf("\tsearching %lu pattern queries (%d times)... ", queries.size(), repeat_count); fflush(stdout);
+    volatile int k = repeat_count;
+    int result = 0;
+    Clock::rep best_time = std::numeric_limits<Clock::rep>::max();
+    while (k--) {
+        const auto t1 = Clock::now();
+        for (const auto& query: queries) {
+            result += db.count(query);
+        }
+        const auto t2 = Clock::now();
+        best_time = std::min(best_time, elapsed(t1, t2));
+    }
+
+    printf("%d match(es), %lu ms\n", result, best_time);
+}
+
+
+// Typo-tolerant search for words of at least 6 characters, within one edit.
+void test_fuzzy_performance(const DB& db, const Collection& words, int repeat_count) {
+
+    constexpr size_t max_queries = 1000;
+
+    std::vector<Query> queries;
+    for (const auto word: words) {
+        if (word.size() >= 6 && queries.size() < max_queries) {
+            queries.push_back(fuzzy_query(word, 1));
+        }
+    }
+
+    printf("\tsearching %lu fuzzy queries (%d times)... ", queries.size(), repeat_count); fflush(stdout);
+    volatile int k = repeat_count;
+    int result = 0;
+    Clock::rep best_time = std::numeric_limits<Clock::rep>::max();
+    while (k--) {
+        const auto t1 = Clock::now();
+        for (const auto& query: queries) {
+            result += db.count(query);
+        }
+        const auto t2 = Clock::now();
+        best_time = std::min(best_time, elapsed(t1, t2));
+    }
+
+    printf("%d match(es), %lu ms\n", result, best_time);
+}
+
+
+// Queries are evaluated by a thread pool, in chunks of a few queries.
+void test_parallel_performance(const DB& db, const Collection& words, int repeat_count) {
+
+    constexpr size_t grain = 8;
+
+    const std::vector<std::string_view> queries(words.begin(), words.end());
+    std::vector<int> results(queries.size());
+
+    const size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads=1; threads <= max_threads; threads++) {
+        ThreadPool pool(threads);
+
+        printf("\tsearching with %lu thread(s) (%d times)... ", threads, repeat_count); fflush(stdout);
+        volatile int k = repeat_count;
+        int result = 0;
+        Clock::rep best_time = std::numeric_limits<Clock::rep>::max();
+        while (k--) {
+            const auto t1 = Clock::now();
+            pool.for_each_range(queries.size(), grain, [&db, &queries, &results](size_t first, size_t last) {
+                for (size_t i=first; i < last; i++) {
+                    results[i] = db.matches(queries[i]);
+                }
+            });
+            const auto t2 = Clock::now();
+            best_time = std::min(best_time, elapsed(t1, t2));
+
+            for (const int r: results) {
+                result += r;
+            }
+        }
+
+        const double qps = queries.size() * 1000.0 / std::max(Clock::rep(1), best_time);
+        printf("%d match(es), %lu ms, %0.0f queries/s\n", result, best_time, qps);
+    }
+}
+
+
 template <typename DBTYPE>
-DBTYPE create(const Collection& collection) {
+DBTYPE create(const Collection& collection, BuilderOptions options = {}) {
 
-    Builder<typename DBTYPE::bitvector_type> builder(collection.size());
+    Builder<typename DBTYPE::bitvector_type> builder(collection.size(), options);
 
     printf("\tbuilding..."); fflush(stdout);
     const auto t1 = Clock::now();
@@ -100,13 +330,255 @@ DBTYPE create(const Collection& collection) {
 }
 
 
+template <typename DBTYPE>
+DBTYPE create_mapped(const Collection& collection, const char* path) {
+
+    using bitvector_type = typename DBTYPE::bitvector_type;
+
+    {
+        Builder<bitvector_type> builder(collection.size());
+        builder.add(collection);
+
+        printf("\tsaving..."); fflush(stdout);
+        const auto t1 = Clock::now();
+        save_index(builder.capture(), path);
+        const auto t2 = Clock::now();
+        printf("%lu ms\n", elapsed(t1, t2));
+    }
+
+    printf("\topening..."); fflush(stdout);
+    const auto t1 = Clock::now();
+    auto index = open_index<bitvector_type>(path);
+    const auto t2 = Clock::now();
+
+    DBTYPE db{collection, std::move(index)};
+    std::remove(path);
+
+    const size_t bytes = db.get_index().size_in_bytes();
+    const double MiBs  = bytes / double(1024 * 1024);
+    printf("%lu ms, size %lu B (%0.3f MiB)\n", elapsed(t1, t2), bytes, MiBs);
+
+    return db;
+}
+
+
+template <typename DBTYPE>
+DBTYPE create_sharded(const Collection& collection, ThreadPool& pool) {
+
+    printf("\tbuilding with %lu thread(s)...", pool.size()); fflush(stdout);
+    const auto t1 = Clock::now();
+    DBTYPE db{collection, pool};
+    const auto t2 = Clock::now();
+
+    const size_t bytes = db.size_in_bytes();
+    const double MiBs  = bytes / double(1024 * 1024);
+    printf("%lu ms, %lu segment(s), size %lu B (%0.3f MiB)\n", elapsed(t1, t2), db.segments_count(), bytes, MiBs);
+
+    return db;
+}
+
+
+// The first pass fills caches, next passes mostly hit them.
+template <typename DBTYPE>
+void test_cached_performance(const Collection& collection, const Collection& words, int repeat_count) {
+
+    Builder<typename DBTYPE::bitvector_type> builder(collection.size());
+    builder.add(collection);
+    const DBTYPE db{collection, builder.capture()};
+
+    test_performance(db, words, 1);
+    test_performance(db, words, repeat_count);
+
+    const CacheStats s = db.stats();
+    auto rate = [](size_t hits, size_t total) {
+        return (total > 0) ? 100.0 * hits / total : 0.0;
+    };
+
+    const size_t lookups = s.intersection_hits + s.prefix_hits + s.intersection_misses;
+    printf("\tresults: %lu hit(s), %lu miss(es), hit rate %0.1f%%, %lu B\n",
+           s.result_hits, s.result_misses, rate(s.result_hits, s.result_hits + s.result_misses), s.result_bytes);
+    printf("\tintersections: %lu hit(s), %lu prefix hit(s), %lu miss(es), hit rate %0.1f%%, %lu B\n",
+           s.intersection_hits, s.prefix_hits, s.intersection_misses,
+           rate(s.intersection_hits + s.prefix_hits, lookups), s.intersection_bytes);
+}
+
+
+// Rows are inserted one by one, then every 10th row is deleted and
+// segments are compacted; queries run before and after compaction.
+template <typename DBTYPE>
+void test_live_updates(const Collection& collection, const Collection& words, int repeat_count) {
+
+    DBTYPE db;
+
+    printf("\tinserting..."); fflush(stdout);
+    const auto t1 = Clock::now();
+    for (const auto row: collection) {
+        db.insert(row);
+    }
+    const auto t2 = Clock::now();
+    printf("%lu ms, %lu segment(s)\n", elapsed(t1, t2), db.snapshot()->segments_count());
+
+    printf("\tdeleting..."); fflush(stdout);
+    const auto t3 = Clock::now();
+    for (size_t id=0; id < collection.size(); id += 10) {
+        db.remove(id);
+    }
+    const auto t4 = Clock::now();
+    printf("%lu ms, %lu row(s) left\n", elapsed(t3, t4), db.size());
+
+    test_performance(db, words, repeat_count);
+
+    printf("\tcompacting..."); fflush(stdout);
+    const auto t5 = Clock::now();
+    db.compact();
+    const auto t6 = Clock::now();
+    printf("%lu ms, %lu segment(s)\n", elapsed(t5, t6), db.snapshot()->segments_count());
+
+    test_performance(db, words, repeat_count);
+}
+
+
+template <typename BITVECTOR>
+void test_build_scaling(const Collection& collection) {
+
+    const size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (size_t threads=1; ; threads = std::min(2*threads, max_threads)) {
+        Builder<BITVECTOR> builder(collection.size());
+
+        printf("\tbuilding with %lu thread(s)...", threads); fflush(stdout);
+        const auto t1 = Clock::now();
+        builder.add(collection, threads);
+        const auto t2 = Clock::now();
+
+        const auto index = builder.capture();
+        printf("%lu ms, %lu trigrams\n", elapsed(t1, t2), index.size());
+
+        if (threads == max_threads) {
+            break;
+        }
+    }
+}
+
+
+template <typename BITVECTOR>
+void test_bulk_build(const Collection& collection) {
+
+    BulkBuilder<BITVECTOR> builder(collection.size());
+
+    printf("\tbulk building..."); fflush(stdout);
+    const auto t1 = Clock::now();
+    builder.add(collection);
+    const auto index = builder.capture();
+    const auto t2 = Clock::now();
+
+    const size_t bytes = index.size_in_bytes();
+    const double MiBs  = bytes / double(1024 * 1024);
+    printf("%lu ms, size %lu B (%0.3f MiB)\n", elapsed(t1, t2), bytes, MiBs);
+}
+
+
+// Compares substring kernels with strstr for queries of different lengths.
+void test_substring_kernels(const Collection& rows, const Collection& words) {
+
+    constexpr size_t max_length = 16;   // the last group contains also longer queries
+    constexpr size_t group_size = 20;
+
+    std::vector<std::vector<size_t>> groups(max_length + 1);
+    for (size_t i=0; i < words.size(); i++) {
+        auto& group = groups[std::min(words[i].size(), max_length)];
+        if (group.size() < group_size) {
+            group.push_back(i);
+        }
+    }
+
+    const auto kernels = substring_kernels();
+
+    printf("	length %10s", "strstr");
+    for (const auto& kernel: kernels) {
+        printf(" %10s", kernel.name);
+    }
+    printf(" [ms, %lu queries]\n", group_size);
+
+    volatile size_t result = 0;
+    for (size_t length=1; length <= max_length; length++) {
+        const auto& group = groups[length];
+        if (group.empty()) {
+            continue;
+        }
+
+        printf("\t%5lu%s", length, (length == max_length) ? "+" : " ");
+
+        const auto t1 = Clock::now();
+        for (const size_t word: group) {
+            for (size_t i=0; i < rows.size(); i++) {
+                result += (strstr(rows.c_str(i), words.c_str(word)) != nullptr);
+            }
+        }
+        const auto t2 = Clock::now();
+        printf(" %10lu", elapsed(t1, t2)); fflush(stdout);
+
+        for (const auto& kernel: kernels) {
+            const auto t1 = Clock::now();
+            for (const size_t word: group) {
+                const auto needle = words[word];
+                for (const auto row: rows) {
+                    result += (kernel.find(row.data(), row.size(), needle.data(), needle.size()) != std::string_view::npos);
+                }
+            }
+            const auto t2 = Clock::now();
+            printf(" %10lu", elapsed(t1, t2)); fflush(stdout);
+        }
+
+        putchar('\n');
+    }
+}
+
+
+// Compares bitops kernels on random bitvectors having as many bits as rows.
+void test_bitops_kernels(const Collection& rows) {
+
+    constexpr size_t repeat = 10000;
+
+    const size_t n = (rows.size() + 63) / 64;
+    std::vector<uint64_t> a(n);
+    std::vector<uint64_t> b(n);
+    std::vector<uint64_t> c(n);
+    for (size_t i=0; i < n; i++) {
+        a[i] = uint64_t(rand()) * uint64_t(rand());
+        b[i] = uint64_t(rand()) * uint64_t(rand());
+    }
+
+    printf("\t%10s %10s %10s [ms, %lu repeats]\n", "kernel", "popcount", "and_count", repeat);
+
+    volatile size_t result = 0;
+    for (const auto& kernel: bitops_kernels()) {
+        printf("\t%10s", kernel.name);
+
+        const auto t1 = Clock::now();
+        for (size_t i=0; i < repeat; i++) {
+            result += kernel.popcount(a.data(), n);
+        }
+        const auto t2 = Clock::now();
+        printf(" %10lu", elapsed(t1, t2)); fflush(stdout);
+
+        const auto t3 = Clock::now();
+        for (size_t i=0; i < repeat; i++) {
+            result += kernel.and_count(c.data(), a.data(), b.data(), n);
+        }
+        const auto t4 = Clock::now();
+        printf(" %10lu\n", elapsed(t3, t4));
+    }
+}
+
+
 void compare(const DB& db1, const DB& db2, Collection& words) {
 
     for (const auto& word: words) {
         const auto db1_res = db1.matches(word);
         const auto db2_res = db2.matches(word);
         if (db1_res != db2_res) {
-            printf("mismatch for '%s'\n", word.c_str());
+            printf("mismatch for '%.*s'\n", int(word.size()), word.data());
         }
     }
 }
@@ -147,7 +619,26 @@ int main(int argc, char* argv[]) {
     if (enabled(KEYWORD)) {                                 \
         printf("%s\n", #TYPE);                              \
         const auto db = create<TYPE>(input);                \
+        test_build_scaling<TYPE::bitvector_type>(input);    \
+        test_bulk_build<TYPE::bitvector_type>(input);       \
         test_performance(db, words, repeat_count);          \
+        test_short_performance(db, words, repeat_count);    \
+        test_batch_performance(db, words, repeat_count);    \
+        test_limit_performance(db, words, repeat_count);    \
+        test_query_performance(db, words, repeat_count);    \
+        test_pattern_performance(db, words, repeat_count);  \
+        test_fuzzy_performance(db, words, repeat_count);    \
+        test_parallel_performance(db, words, repeat_count); \
+    }
+
+    if (enabled("substring")) {
+        puts("substring kernels");
+        test_substring_kernels(input, words);
+    }
+
+    if (enabled("bitops")) {
+        puts("bitops kernels");
+        test_bitops_kernels(input);
     }
 
     if (true) {
@@ -172,6 +663,158 @@ int main(int argc, char* argv[]) {
 
         using AndAll_BitvectorSparse = IndexedDB<AndAll<bitvector_sparse>>;
         TEST("sparse-all", AndAll_BitvectorSparse);
+
+        using AndAll_BitvectorCompressed = IndexedDB<AndAll<bitvector_compressed>>;
+        TEST("compressed-all", AndAll_BitvectorCompressed);
+
+        using AndAll_BitvectorHybrid = IndexedDB<AndAll<bitvector_hybrid>>;
+        TEST("hybrid-all", AndAll_BitvectorHybrid);
+    }
+
+    if (true) {
+#ifdef ROARING
+        using CostBased_Roaring = IndexedDB<CostBased<roaring_facade>>;
+        TEST("roaring-cost",  CostBased_Roaring);
+#endif
+        using CostBased_Vector = IndexedDB<CostBased<vector_facade>>;
+        TEST("vector-cost", CostBased_Vector);
+
+        using AndMany_Vector = IndexedDB<AndMany<vector_facade>>;
+        TEST("vector-many", AndMany_Vector);
+
+        using CostBased_Bitvector = IndexedDB<CostBased<bitvector_naive>>;
+        TEST("naive-cost", CostBased_Bitvector);
+
+        using CostBased_BitvectorTracking = IndexedDB<CostBased<bitvector_tracking>>;
+        TEST("tracking-cost", CostBased_BitvectorTracking);
+
+        using CostBased_BitvectorSparse = IndexedDB<CostBased<bitvector_sparse>>;
+        TEST("sparse-cost", CostBased_BitvectorSparse);
+
+        using CostBased_BitvectorCompressed = IndexedDB<CostBased<bitvector_compressed>>;
+        TEST("compressed-cost", CostBased_BitvectorCompressed);
+
+        using CostBased_BitvectorHybrid = IndexedDB<CostBased<bitvector_hybrid>>;
+        TEST("hybrid-cost", CostBased_BitvectorHybrid);
+    }
+
+#define TEST_MAPPED(KEYWORD, TYPE)                                      \
+    if (enabled(KEYWORD)) {                                             \
+        printf("%s (mapped)\n", #TYPE);                                 \
+        const auto db = create_mapped<TYPE>(input, "perftest-index.tmp"); \
+        test_performance(db, words, repeat_count);                      \
+    }
+
+    if (true) {
+#ifdef ROARING
+        using AndAll_Roaring = IndexedDB<AndAll<roaring_facade>>;
+        TEST_MAPPED("roaring-mapped",  AndAll_Roaring);
+#endif
+        using AndAll_Vector = IndexedDB<AndAll<vector_facade>>;
+        TEST_MAPPED("vector-mapped", AndAll_Vector);
+
+        using AndAll_Bitvector = IndexedDB<AndAll<bitvector_naive>>;
+        TEST_MAPPED("naive-mapped", AndAll_Bitvector);
+
+        using AndAll_BitvectorTracking = IndexedDB<AndAll<bitvector_tracking>>;
+        TEST_MAPPED("tracking-mapped", AndAll_BitvectorTracking);
+    }
+
+#define TEST_SHORT(KEYWORD, TYPE)                                       \
+    if (enabled(KEYWORD)) {                                             \
+        BuilderOptions options;                                         \
+        options.short_postings = true;                                  \
+        printf("%s (short postings)\n", #TYPE);                         \
+        const auto db = create<TYPE>(input, options);                   \
+        test_short_performance(db, words, repeat_count);                \
+        test_performance(db, words, repeat_count);                      \
+    }
+
+    if (true) {
+        using AndAll_Vector = IndexedDB<AndAll<vector_facade>>;
+        TEST_SHORT("vector-short", AndAll_Vector);
+
+        using AndAll_BitvectorCompressed = IndexedDB<AndAll<bitvector_compressed>>;
+        TEST_SHORT("compressed-short", AndAll_BitvectorCompressed);
+    }
+
+#define TEST_NGRAM(KEYWORD, TYPE)                                       \
+    if (enabled(KEYWORD)) {                                             \
+        BuilderOptions options;                                         \
+        options.frequent_trigrams = 256;                                \
+        printf("%s (4-grams of frequent trigrams)\n", #TYPE);           \
+        const auto db = create<TYPE>(input, options);                   \
+        test_performance(db, words, repeat_count);                      \
+    }
+
+    if (true) {
+        using AndAll_Vector = IndexedDB<AndAll<vector_facade>>;
+        TEST_NGRAM("vector-ngram", AndAll_Vector);
+
+        using AndAll_BitvectorCompressed = IndexedDB<AndAll<bitvector_compressed>>;
+        TEST_NGRAM("compressed-ngram", AndAll_BitvectorCompressed);
+    }
+
+#define TEST_SHARDED(KEYWORD, TYPE)                                     \
+    if (enabled(KEYWORD)) {                                             \
+        printf("%s (sharded)\n", #TYPE);                                \
+        ThreadPool pool(std::max(1u, std::thread::hardware_concurrency())); \
+        const auto db = create_sharded<TYPE>(input, pool);              \
+        test_performance(db, words, repeat_count);                      \
+    }
+
+    if (true) {
+        using Sharded_Vector = ShardedDB<AndAll<vector_facade>>;
+        TEST_SHARDED("vector-sharded", Sharded_Vector);
+
+        using Sharded_Vector16 = ShardedDB<AndAll<vector16_facade>>;
+        TEST_SHARDED("vector16-sharded", Sharded_Vector16);
+
+        using Sharded_Bitvector = ShardedDB<AndAll<bitvector_naive>>;
+        TEST_SHARDED("naive-sharded", Sharded_Bitvector);
+    }
+
+#define TEST_LIVE(KEYWORD, TYPE)                                        \
+    if (enabled(KEYWORD)) {                                             \
+        printf("%s (live)\n", #TYPE);                                   \
+        test_live_updates<TYPE>(input, words, repeat_count);            \
+    }
+
+    if (true) {
+        using Live_Vector = LiveDB<AndAll<vector_facade>>;
+        TEST_LIVE("vector-live", Live_Vector);
+
+        using Live_Bitvector = LiveDB<AndAll<bitvector_naive>>;
+        TEST_LIVE("naive-live", Live_Bitvector);
+    }
+
+#define TEST_POSITIONAL(KEYWORD, TYPE)                                   \
+    if (enabled(KEYWORD)) {                                             \
+        printf("%s (positional)\n", #TYPE);                             \
+        const auto db = create<TYPE>(input);                            \
+        const size_t bytes = db.get_positional_index().size_in_bytes(); \
+        printf("\tpositional index size %lu B (%0.3f MiB)\n", bytes, bytes / double(1024 * 1024)); \
+        test_performance(db, words, repeat_count);                      \
+        test_limit_performance(db, words, repeat_count);                \
+    }
+
+    if (true) {
+        using Positional_Vector = PositionalDB<AndAll<vector_facade>>;
+        TEST_POSITIONAL("vector-positional", Positional_Vector);
+    }
+
+#define TEST_CACHED(KEYWORD, TYPE)                                      \
+    if (enabled(KEYWORD)) {                                             \
+        printf("%s (cached)\n", #TYPE);                                 \
+        test_cached_performance<TYPE>(input, words, repeat_count);      \
+    }
+
+    if (true) {
+        using Cached_Vector = CachedDB<AndAll<vector_facade>>;
+        TEST_CACHED("vector-cached", Cached_Vector);
+
+        using Cached_Bitvector = CachedDB<AndAll<bitvector_naive>>;
+        TEST_CACHED("naive-cached", Cached_Bitvector);
     }
 
     if (false) {
@@ -0,0 +1,111 @@
+#include "bitops.h"
+
+#include <random>
+#include <vector>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+
+std::vector<uint64_t> random_words(std::mt19937_64& random, size_t n) {
+    std::vector<uint64_t> words(n);
+    for (auto& w: words) {
+        w = random();
+    }
+
+    return words;
+}
+
+
+void test_kernel(const bitops_kernel& kernel) {
+    std::mt19937_64 random(0);
+
+    for (size_t n=0; n < 300; n++) {
+        const auto a = random_words(random, n);
+        const auto b = random_words(random, n);
+
+        if (kernel.popcount(a.data(), n) != bitops_popcount_scalar(a.data(), n)) {
+            printf("%s: popcount failed for n=%lu\n", kernel.name, n);
+            assert(false);
+        }
+
+        std::vector<uint64_t> expected(n);
+        const size_t count = bitops_and_count_scalar(expected.data(), a.data(), b.data(), n);
+
+        std::vector<uint64_t> c(n);
+        if (kernel.and_count(c.data(), a.data(), b.data(), n) != count || c != expected) {
+            printf("%s: and_count failed for n=%lu\n", kernel.name, n);
+            assert(false);
+        }
+
+        // in-place
+        c = a;
+        if (kernel.and_count(c.data(), c.data(), b.data(), n) != count || c != expected) {
+            printf("%s: in-place and_count failed for n=%lu\n", kernel.name, n);
+            assert(false);
+        }
+    }
+}
+
+
+void test_all_ones() {
+    // counters of the vectorized kernels must not overflow
+    const size_t n = 100000;
+    const std::vector<uint64_t> a(n, ~uint64_t(0));
+    std::vector<uint64_t> c(n);
+
+    for (const auto& kernel: bitops_kernels()) {
+        assert(kernel.popcount(a.data(), n) == 64 * n);
+        assert(kernel.and_count(c.data(), a.data(), a.data(), n) == 64 * n);
+    }
+}
+
+
+void test_decoder() {
+    std::mt19937_64 random(0);
+
+    for (size_t n=0; n < 100; n++) {
+        auto a = random_words(random, n);
+        if (n % 3 == 1) {
+            // sparse words
+            for (auto& w: a) {
+                w &= random() & random() & random();
+            }
+        }
+
+        const size_t base = 64 * n;
+        std::vector<uint32_t> expected;
+        for (size_t i=0; i < 64 * n; i++) {
+            if (a[i / 64] & (uint64_t(1) << (i % 64))) {
+                expected.push_back(base + i);
+            }
+        }
+
+        std::vector<uint32_t> result;
+        bitops_visit_batches(a.data(), n, base, [&result](const uint32_t* ids, size_t count) {
+            assert(count > 0);
+            result.insert(result.end(), ids, ids + count);
+        });
+
+        assert(result == expected);
+    }
+}
+
+
+void test() {
+    for (const auto& kernel: bitops_kernels()) {
+        test_kernel(kernel);
+    }
+
+    test_all_ones();
+    test_decoder();
+}
+
+
+int main() {
+    test();
+
+    puts("All OK");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+#include <vector>
+#include <optional>
+#include <random>
+#include <algorithm>
+#include <iterator>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "bitvector_compressed.h"
+
+
+// ids with gaps of all encoded lengths (1 to 4 bytes)
+std::vector<uint32_t> random_ids(std::mt19937& random, size_t n, size_t size) {
+    std::uniform_int_distribution<int> length(0, 3);
+    std::uniform_int_distribution<uint32_t> gap(1, 255);
+
+    std::vector<uint32_t> ids;
+    uint32_t id = gap(random);
+    while (ids.size() < n && id < size) {
+        ids.push_back(id);
+        id += gap(random) << (length(random) * 7);
+    }
+
+    return ids;
+}
+
+
+bitvector_compressed make(size_t size, const std::vector<uint32_t>& ids) {
+    bitvector_compressed bv(size);
+    for (const uint32_t id: ids) {
+        bv.set(id);
+    }
+
+    bv.update_internal_structures();
+    return bv;
+}
+
+
+std::vector<uint32_t> items(const bitvector_compressed& bv) {
+    std::vector<uint32_t> result;
+    bv.visit([&result](uint32_t id) {
+        result.push_back(id);
+    });
+
+    return result;
+}
+
+
+void test_set_and_visit() {
+    std::mt19937 random(0);
+
+    for (size_t n: {0, 1, 127, 128, 129, 256, 1000, 5000}) {
+        const auto ids = random_ids(random, n, 1 << 30);
+        const auto bv = make(1 << 30, ids);
+
+        assert(bv.cardinality() == ids.size());
+        assert(items(bv) == ids);
+    }
+}
+
+
+void test_duplicates() {
+    bitvector_compressed bv(1000);
+    for (size_t i=0; i < 200; i++) {
+        bv.set(i);
+        bv.set(i);
+    }
+
+    assert(bv.cardinality() == 200);
+}
+
+
+void test_and() {
+    std::mt19937 random(0);
+
+    for (size_t n1: {1, 100, 1000, 10000}) {
+        for (size_t n2: {1, 100, 1000, 10000}) {
+            // a small universe yields many common ids
+            std::vector<uint32_t> a;
+            std::vector<uint32_t> b;
+            for (uint32_t i=0; i < 20000; i++) {
+                if (random() % 20000 < n1) a.push_back(i);
+                if (random() % 20000 < n2) b.push_back(i);
+            }
+
+            std::vector<uint32_t> expected;
+            std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+
+            const auto bv1 = make(20000, a);
+            const auto bv2 = make(20000, b);
+
+            const auto result = bitvector_compressed::bit_and(bv1, bv2);
+            assert(result.has_value() == !expected.empty());
+            if (result.has_value()) {
+                assert(items(result.value()) == expected);
+            }
+
+            auto inplace = bv1;
+            assert(bitvector_compressed::bit_and_inplace(inplace, bv2) == !expected.empty());
+            assert(items(inplace) == expected);
+        }
+    }
+}
+
+
+void test_or() {
+    std::mt19937 random(0);
+
+    const auto a = random_ids(random, 3000, 1 << 20);
+    const auto b = random_ids(random, 2000, 1 << 20);
+
+    std::vector<uint32_t> expected;
+    std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+
+    auto bv1 = make(1 << 20, a);
+    const auto bv2 = make(1 << 20, b);
+    bitvector_compressed::bit_or_inplace(bv1, bv2);
+
+    assert(bv1.cardinality() == expected.size());
+    assert(items(bv1) == expected);
+}
+
+
+void test() {
+    test_set_and_visit();
+    test_duplicates();
+    test_and();
+    test_or();
+}
+
+
+int main() {
+    test();
+
+    puts("All OK");
+    return EXIT_SUCCESS;
+}
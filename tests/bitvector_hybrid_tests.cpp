@@ -0,0 +1,160 @@
+#include <vector>
+#include <optional>
+#include <random>
+#include <algorithm>
+#include <iterator>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "bitvector_hybrid.h"
+
+using representation = bitvector_hybrid::representation;
+
+const size_t size = 10000;
+
+
+std::vector<uint32_t> sample(std::mt19937& random, representation kind) {
+    std::vector<uint32_t> ids;
+    switch (kind) {
+        case representation::array:
+            for (uint32_t i=0; i < size; i++) {
+                if (random() % 100 == 0) ids.push_back(i);
+            }
+            break;
+
+        case representation::dense:
+            for (uint32_t i=0; i < size; i++) {
+                if (random() % 3 == 0) ids.push_back(i);
+            }
+            break;
+
+        case representation::runs:
+            for (uint32_t i=random() % 50; i < size; i += 200 + random() % 300) {
+                const uint32_t n = 50 + random() % 100;
+                for (uint32_t j=i; j < std::min(uint32_t(size), i + n); j++) {
+                    ids.push_back(j);
+                }
+            }
+            break;
+    }
+
+    return ids;
+}
+
+
+bitvector_hybrid make(const std::vector<uint32_t>& ids) {
+    bitvector_hybrid bv(size);
+    for (const uint32_t id: ids) {
+        bv.set(id);
+    }
+
+    bv.update_internal_structures();
+    return bv;
+}
+
+
+std::vector<uint32_t> items(const bitvector_hybrid& bv) {
+    std::vector<uint32_t> result;
+    bv.visit([&result](uint32_t id) {
+        result.push_back(id);
+    });
+
+    return result;
+}
+
+
+const representation all[] = {representation::array, representation::dense, representation::runs};
+
+
+void test_representation() {
+    std::mt19937 random(0);
+
+    for (const auto kind: all) {
+        const auto ids = sample(random, kind);
+        const auto bv  = make(ids);
+
+        assert(bv.get_representation() == kind);
+        assert(bv.cardinality() == ids.size());
+        assert(items(bv) == ids);
+    }
+}
+
+
+void test_and() {
+    std::mt19937 random(0);
+
+    for (const auto kind1: all) {
+        for (const auto kind2: all) {
+            const auto a = sample(random, kind1);
+            const auto b = sample(random, kind2);
+
+            std::vector<uint32_t> expected;
+            std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+
+            const auto bv1 = make(a);
+            const auto bv2 = make(b);
+
+            const auto result = bitvector_hybrid::bit_and(bv1, bv2);
+            assert(result.has_value());
+            assert(result->cardinality() == expected.size());
+            assert(items(result.value()) == expected);
+
+            auto inplace = bv1;
+            assert(bitvector_hybrid::bit_and_inplace(inplace, bv2));
+            assert(inplace.cardinality() == expected.size());
+            assert(items(inplace) == expected);
+        }
+    }
+}
+
+
+void test_and_empty() {
+    bitvector_hybrid bv1(size);
+    bitvector_hybrid bv2(size);
+    bv1.set(1);
+    bv2.set(2);
+
+    assert(!bitvector_hybrid::bit_and(bv1, bv2).has_value());
+    assert(!bitvector_hybrid::bit_and_inplace(bv1, bv2));
+}
+
+
+void test_or() {
+    std::mt19937 random(0);
+
+    for (const auto kind1: all) {
+        for (const auto kind2: all) {
+            const auto a = sample(random, kind1);
+            const auto b = sample(random, kind2);
+
+            std::vector<uint32_t> expected;
+            std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+
+            auto bv1 = make(a);
+            const auto bv2 = make(b);
+            bitvector_hybrid::bit_or_inplace(bv1, bv2);
+            bv1.update_internal_structures();
+
+            assert(bv1.cardinality() == expected.size());
+            assert(items(bv1) == expected);
+        }
+    }
+}
+
+
+void test() {
+    test_representation();
+    test_and();
+    test_and_empty();
+    test_or();
+}
+
+
+int main() {
+    test();
+
+    puts("All OK");
+    return EXIT_SUCCESS;
+}
@@ -1,6 +1,8 @@
 #include "bitvector_sparse.h"
 
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
 
 void test_basic_operations() {
     bitvector_sparse bv(1000);
@@ -0,0 +1,120 @@
+#include <vector>
+#include <string>
+#include <optional>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef ROARING
+#   include <roaring.c>
+#endif
+
+#include "Builder.h"
+#include "ThreadPool.h"
+
+#include "bitvector_naive.h"
+#include "bitvector_tracking.h"
+#include "bitvector_sparse.h"
+#include "bitvector_hybrid.h"
+#include "bitvector_compressed.h"
+#include "vector_facade.h"
+#include "vector16_facade.h"
+#include "deque_facade.h"
+#include "list_facade.h"
+#ifdef ROARING
+#   include "roaring_facade.h"
+#endif
+
+#include "common.h"
+
+
+// Sorted, some containers visit items in reverse order.
+template <typename BITVECTOR>
+std::vector<size_t> items(const BITVECTOR& bv) {
+    std::vector<size_t> result;
+    bv.visit([&result](size_t index) {
+        result.push_back(index);
+    });
+
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+
+// Both indexes have the same keys and postings, the order of keys
+// depends on the order of merging.
+template <typename BITVECTOR>
+void check_same(const Index<BITVECTOR>& index, const Index<BITVECTOR>& expected) {
+    assert(index.size() == expected.size());
+    assert(index.short_postings == expected.short_postings);
+    assert(index.frequent_cardinality == expected.frequent_cardinality);
+
+    for (size_t i=0; i < expected.size(); i++) {
+        const auto* item = index.find(expected.trigrams[i]);
+        assert(item != nullptr);
+        assert(item->get_cardinality() == expected.items[i].get_cardinality());
+        assert(items(item->bv) == items(expected.items[i].bv));
+    }
+}
+
+
+template <typename BITVECTOR>
+void test_threads(const Collection& coll, BuilderOptions options) {
+    Builder<BITVECTOR> single(coll.size(), options);
+    single.add(coll);
+    const auto expected = single.capture();
+    assert(expected.size() > 0);
+
+    for (const size_t threads: {1, 2, 4}) {
+        Builder<BITVECTOR> builder(coll.size(), options);
+        builder.add(coll, threads);
+        check_same(builder.capture(), expected);
+    }
+
+    // a pool shared with other work
+    ThreadPool pool(3);
+    Builder<BITVECTOR> builder(coll.size(), options);
+    builder.add(coll, pool);
+    check_same(builder.capture(), expected);
+}
+
+
+template <typename BITVECTOR>
+void test_threads() {
+    const Collection coll = sample_collection(3000, {"warszawa", "wroclaw", "ab", ""});
+
+    BuilderOptions options;
+    test_threads<BITVECTOR>(coll, options);
+
+    options.short_postings = true;
+    options.frequent_trigrams = 4;
+    test_threads<BITVECTOR>(coll, options);
+
+    // fewer rows than threads
+    test_threads<BITVECTOR>(sample_collection(0, {"abcd", "bcde", "cdef"}), options);
+}
+
+
+void test() {
+    test_threads<bitvector_naive>();
+    test_threads<bitvector_tracking>();
+    test_threads<bitvector_sparse>();
+    test_threads<bitvector_hybrid>();
+    test_threads<bitvector_compressed>();
+    test_threads<vector_facade>();
+    test_threads<vector16_facade>();
+    test_threads<deque_facade>();
+    test_threads<list_facade>();
+#ifdef ROARING
+    test_threads<roaring_facade>();
+#endif
+}
+
+
+int main() {
+    test();
+
+    puts("All OK");
+    return EXIT_SUCCESS;
+}
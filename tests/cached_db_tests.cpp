@@ -0,0 +1,221 @@
+#include <vector>
+#include <string>
+#include <optional>
+#include <thread>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Builder.h"
+#include "DB.h"
+#include "NaiveDB.h"
+#include "CachedDB.h"
+#include "combiner/all.h"
+
+#include "bitvector_naive.h"
+#include "vector_facade.h"
+
+#include "common.h"
+
+
+void test_lru_cache() {
+    // a single shard, thus the order of eviction is known; entries
+    // are large enough to make the cost of nodes irrelevant
+    constexpr size_t bytes = 10000;
+    LRUCache<int> cache(4 * bytes + 1000, 1);
+
+    cache.insert("a", 1, bytes);
+    cache.insert("b", 2, bytes);
+    cache.insert("c", 3, bytes);
+    cache.insert("d", 4, bytes);
+    assert(cache.size() == 4);
+
+    // "a" becomes the most recently used, "b" is evicted
+    assert(cache.find("a") == 1);
+    cache.insert("e", 5, bytes);
+    assert(cache.size() == 4);
+    assert(!cache.find("b").has_value());
+    assert(cache.find("a") == 1);
+    assert(cache.find("c") == 3);
+    assert(cache.find("e") == 5);
+    assert(cache.size_in_bytes() <= cache.capacity());
+
+    // too large entries are not stored
+    cache.insert("huge", 6, cache.capacity());
+    assert(!cache.find("huge").has_value());
+    assert(cache.find("e") == 5);
+
+    cache.clear();
+    assert(cache.size() == 0);
+    assert(cache.size_in_bytes() == 0);
+    assert(!cache.find("a").has_value());
+}
+
+
+Collection sample_collection() {
+    return sample_collection(500, {"london", "londonderry", "new london", "londrina", "lond", "paris", "parisian londoner"});
+}
+
+
+const std::vector<std::string_view> queries = {
+    "lon", "lond", "london", "londonderry", "londoner", "londrina", "londonderryx",
+    "paris", "parisian", "xyz", "xyzw", "", "o", "on", "row 1", "row 12", "ow 1", "12"
+};
+
+
+template <typename COMBINER>
+void test_db(size_t results_limit, size_t intersections_limit) {
+    const Collection coll = sample_collection();
+    const NaiveDB naive(coll);
+
+    Builder<typename COMBINER::bitvector_type> builder(coll.size());
+    builder.add(coll);
+    CachedDB<COMBINER> db(coll, builder.capture(), results_limit, intersections_limit);
+
+    for (size_t round=0; round < 3; round++) {
+        for (const auto& word: queries) {
+            assert(db.matches(word) == naive.matches(word));
+        }
+    }
+
+    const CacheStats stats = db.stats();
+    assert(stats.result_hits + stats.result_misses == 3 * queries.size());
+    if (results_limit > 0) {
+        assert(stats.result_misses == queries.size());
+        assert(stats.result_hits == 2 * queries.size());
+    }
+
+    check_words(db, naive, queries, true);
+
+    db.clear_caches();
+    assert(db.stats().result_bytes == 0);
+    assert(db.stats().intersection_bytes == 0);
+}
+
+
+void test_prefix_hits() {
+    const Collection coll = sample_collection();
+
+    Builder<vector_facade> builder(coll.size());
+    builder.add(coll);
+    CachedDB<AndAll<vector_facade>> db(coll, builder.capture());
+
+    assert(db.matches("london") == 4);
+    assert(db.stats().intersection_misses == 1);
+
+    // the intersection for "london" is reused
+    assert(db.matches("londonderry") == 1);
+    assert(db.stats().prefix_hits == 1);
+    assert(db.stats().intersection_misses == 1);
+
+    // "london" is a prefix again
+    assert(db.matches("londonon") == 0);
+    assert(db.stats().intersection_hits == 0);
+    assert(db.stats().prefix_hits == 2);
+
+    // an empty intersection
+    assert(db.matches("xyzw") == 0);
+    assert(db.matches("xyzwv") == 0);
+    assert(db.stats().prefix_hits == 3);
+
+    // repeated trigrams: "ondondon" has the same key as "ondon"
+    assert(db.matches("ondon") == 4);
+    assert(db.matches("ondondon") == 0);
+    assert(db.stats().intersection_hits == 1);
+    assert(db.matches("ondondonx") == 0);
+    assert(db.stats().prefix_hits == 4);
+    assert(db.stats().intersection_misses == 3);
+}
+
+
+// With 4-gram keys the caches give the same answers as IndexedDB.
+template <typename COMBINER>
+void test_frequent_trigrams() {
+    const Collection coll = sample_collection();
+
+    BuilderOptions options;
+    options.frequent_trigrams = 8;
+
+    using bitvector_type = typename COMBINER::bitvector_type;
+    Builder<bitvector_type> builder(coll.size(), options);
+    builder.add(coll);
+    auto index = builder.capture();
+    assert(index.frequent_cardinality > 0);
+
+    Builder<bitvector_type> copy(coll.size(), options);
+    copy.add(coll);
+    const IndexedDB<COMBINER> expected(coll, copy.capture());
+    CachedDB<COMBINER> db(coll, std::move(index), 0, 1 << 20);
+
+    std::vector<std::string_view> words(queries.begin(), queries.end());
+    for (const char* word: {"row 12 1", "row 123", "ow 1 ", "row 1 7", "w 1", "londonderry 1", "row 99"}) {
+        words.push_back(word);
+    }
+
+    for (size_t round=0; round < 2; round++) {
+        for (const auto& word: words) {
+            assert(db.matches(word) == expected.matches(word));
+            assert(db.find_rows(word) == expected.find_rows(word));
+        }
+    }
+
+    assert(db.stats().intersection_hits > 0);
+    assert(db.stats().prefix_hits > 0);
+}
+
+
+void test_concurrent_readers() {
+    const Collection coll = sample_collection();
+    const NaiveDB naive(coll);
+
+    Builder<vector_facade> builder(coll.size());
+    builder.add(coll);
+    const CachedDB<AndAll<vector_facade>> db(coll, builder.capture(), 4096, 4096);
+
+    std::vector<int> expected;
+    for (const auto& word: queries) {
+        expected.push_back(naive.matches(word));
+    }
+
+    auto reader = [&db, &expected](size_t seed) {
+        for (size_t i=0; i < 2000; i++) {
+            const size_t q = (i * 31 + seed) % queries.size();
+            assert(db.matches(queries[q]) == expected[q]);
+        }
+    };
+
+    std::thread t1(reader, 1);
+    std::thread t2(reader, 2);
+    std::thread t3(reader, 3);
+    t1.join();
+    t2.join();
+    t3.join();
+}
+
+
+void test() {
+    test_lru_cache();
+    test_prefix_hits();
+
+    test_db<AndAll<vector_facade>>(1 << 20, 1 << 20);
+    test_db<AndAll<vector_facade>>(0, 1 << 20);
+    test_db<AndAll<vector_facade>>(0, 0);
+    test_db<CostBased<vector_facade>>(0, 1 << 20);
+    test_db<PickCheapest<bitvector_naive>>(0, 1 << 20);
+    test_db<AndAll<bitvector_naive>>(1 << 20, 1 << 20);
+
+    test_frequent_trigrams<AndAll<vector_facade>>();
+    test_frequent_trigrams<PickCheapest<vector_facade>>();
+    test_frequent_trigrams<CostBased<bitvector_naive>>();
+
+    test_concurrent_readers();
+}
+
+
+int main() {
+    test();
+
+    puts("All OK");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+// Fixtures and checks shared by unit tests.
+
+#include <algorithm>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cassert>
+
+#include "types.h"
+#include "DB.h"
+#include "NaiveDB.h"
+#include "Query.h"
+
+
+// The given rows followed by n generated ones, "row <number> <i % 13>";
+// numbers are scattered, thus trigrams have various cardinalities.
+inline Collection sample_collection(size_t n, std::initializer_list<const char*> rows = {}) {
+    Collection coll;
+    for (const char* row: rows) {
+        coll.emplace_back(row);
+    }
+
+    for (size_t i=0; i < n; i++) {
+        coll.emplace_back("row " + std::to_string(i * 7919 % 10007) + " " + std::to_string(i % 13));
+    }
+
+    return coll;
+}
+
+
+// Rows are compared as sets, unless a database returns them in order.
+inline void check_rows(std::vector<size_t> rows, std::vector<size_t> expected, size_t limit, bool ordered = false) {
+    if (!ordered) {
+        std::sort(rows.begin(), rows.end());
+        std::sort(expected.begin(), expected.end());
+    }
+
+    if (limit >= expected.size()) {
+        assert(rows == expected);
+    } else if (ordered) {
+        assert(rows.size() == limit);
+        assert(std::equal(rows.begin(), rows.end(), expected.begin()));
+    } else {
+        assert(rows.size() == limit);
+        assert(std::includes(expected.begin(), expected.end(), rows.begin(), rows.end()));
+    }
+}
+
+
+// Answers for the words are the same as those of NaiveDB.
+template <typename WORDS>
+void check_words(const DB& db, const NaiveDB& naive, const WORDS& words, bool ordered = false) {
+    const std::vector<std::string_view> batch(words.begin(), words.end());
+    std::vector<int> results(batch.size(), -1);
+    db.matches_batch(batch.data(), batch.size(), results.data());
+
+    for (size_t i=0; i < batch.size(); i++) {
+        const auto word = batch[i];
+        const auto expected = naive.find_rows(word);
+        assert(db.matches(word) == int(expected.size()));
+        assert(results[i] == int(expected.size()));
+
+        for (const size_t limit: {size_t(0), size_t(1), size_t(3), size_t(20), size_t(1000), DB::unlimited}) {
+            check_rows(db.find_rows(word, limit), expected, limit, ordered);
+        }
+
+        // the visitor stops early
+        size_t visited = 0;
+        const size_t count = db.visit_matches(word, DB::unlimited, [&visited](size_t) {
+            visited += 1;
+            return visited < 5;
+        });
+        assert(count == visited);
+        assert(count == std::min(size_t(5), expected.size()));
+    }
+}
+
+
+// Rows matching the query, found by a scan.
+inline std::vector<size_t> expected_rows(const Collection& coll, const Query& query) {
+    std::vector<size_t> rows;
+    for (size_t i=0; i < coll.size(); i++) {
+        if (query.matches(coll[i])) {
+            rows.push_back(i);
+        }
+    }
+
+    return rows;
+}
+
+
+// Answers for the queries are the rows matching them.
+inline void check_queries(const DB& db, const Collection& coll, const std::vector<Query>& queries) {
+    for (const auto& query: queries) {
+        const auto expected = expected_rows(coll, query);
+        assert(size_t(db.count(query)) == expected.size());
+
+        for (const size_t limit: {size_t(0), size_t(1), size_t(3), size_t(20), DB::unlimited}) {
+            check_rows(db.find_rows(query, limit), expected, limit);
+        }
+    }
+}
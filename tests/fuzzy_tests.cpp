@@ -0,0 +1,193 @@
+#include <vector>
+#include <string>
+#include <optional>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Builder.h"
+#include "DB.h"
+#include "NaiveDB.h"
+#include "IndexedDB.h"
+#include "QueryPlanner.h"
+#include "ShardedDB.h"
+#include "LiveDB.h"
+#include "Pattern.h"
+#include "combiner/all.h"
+
+#include "bitvector_naive.h"
+#include "bitvector_compressed.h"
+#include "vector_facade.h"
+
+#include "common.h"
+
+
+Collection sample_collection() {
+    return sample_collection(2000, {"warszawa", "warsawa", "warszwa", "wasrzawa", "new warszawa city", "londonderry", "lodnon", ""});
+}
+
+
+// Sellers' algorithm, the minimum edit distance of needle to a substring of s
+size_t min_distance(std::string_view s, std::string_view needle) {
+    std::vector<size_t> prev(needle.size() + 1);
+    for (size_t i=0; i <= needle.size(); i++) {
+        prev[i] = i;
+    }
+
+    size_t best = prev.back();
+    for (const char c: s) {
+        std::vector<size_t> curr(needle.size() + 1, 0);
+        for (size_t i=1; i <= needle.size(); i++) {
+            curr[i] = std::min({prev[i] + 1, curr[i - 1] + 1, prev[i - 1] + (needle[i - 1] != c)});
+        }
+
+        best = std::min(best, curr.back());
+        prev = std::move(curr);
+    }
+
+    return best;
+}
+
+
+void test_approximate() {
+    const Collection coll = sample_collection();
+
+    std::string long_needle;
+    for (int i=0; i < 10; i++) {
+        long_needle += "row 123 ";
+    }
+
+    for (const auto needle: {"warszawa", "warsaw", "london", "lodnon", "row 1234", "ow 9", "x", "", long_needle.c_str()}) {
+        for (const auto row: coll) {
+            const size_t d = min_distance(row, needle);
+            for (size_t k=0; k <= 3; k++) {
+                assert(substring_contains_approximate(row, needle, k) == (d <= k));
+            }
+        }
+    }
+
+    assert(substring_contains_approximate("abc", "abc", 0));
+    assert(!substring_contains_approximate("abd", "abc", 0));
+    assert(substring_contains_approximate("xxabdxx", "abc", 1));
+    assert(substring_contains_approximate("xxacxx", "abc", 1));
+    assert(substring_contains_approximate("", "ab", 2));
+    assert(!substring_contains_approximate("", "abc", 2));
+}
+
+
+void test_toccurrence(size_t n) {
+    std::vector<vector_facade> lists;
+    for (const size_t step: {2, 3, 5, 7}) {
+        vector_facade bv(n);
+        for (size_t i=0; i < n; i += step) {
+            bv.set(i);
+        }
+        lists.push_back(std::move(bv));
+    }
+
+    for (size_t threshold=1; threshold <= lists.size() + 1; threshold++) {
+        TOccurrence<vector_facade> combiner(threshold);
+        for (const auto& bv: lists) {
+            assert(combiner.add(bv, bv.cardinality()));
+        }
+
+        std::vector<size_t> expected;
+        for (size_t i=0; i < n; i++) {
+            const size_t count = (i % 2 == 0) + (i % 3 == 0) + (i % 5 == 0) + (i % 7 == 0);
+            if (count >= threshold) {
+                expected.push_back(i);
+            }
+        }
+
+        const bool found = combiner.finish();
+        assert(found == combiner.has_value());
+        assert(found == !expected.empty());
+
+        std::vector<size_t> rows;
+        if (found) {
+            combiner.value().visit([&rows](size_t row) {
+                rows.push_back(row);
+            });
+        }
+
+        assert(rows == expected);
+    }
+}
+
+
+void check_db(const DB& db, const Collection& coll) {
+    for (const auto word: {"warszawa", "londonderry", "london", "row 1234", "ow 9", "zzzzzz"}) {
+        for (size_t k=0; k <= 2; k++) {
+            const Query query = fuzzy_query(word, k);
+
+            std::vector<size_t> expected;
+            for (size_t i=0; i < coll.size(); i++) {
+                if (min_distance(coll[i], word) <= k) {
+                    expected.push_back(i);
+                }
+            }
+
+            auto rows = db.find_rows(query);
+            std::sort(rows.begin(), rows.end());
+            assert(rows == expected);
+        }
+    }
+
+    // a transposition costs two edits
+    assert(db.count(fuzzy_query("warszawa", 1)) == 4);
+    assert(db.count(fuzzy_query("warszawa", 2)) == 5);
+}
+
+
+void test() {
+    test_approximate();
+    // counters are reused by following queries
+    test_toccurrence(100);
+    test_toccurrence(1000);
+    test_toccurrence(50);
+
+    const Collection coll = sample_collection();
+    check_db(NaiveDB(coll), coll);
+
+    {
+        Builder<vector_facade> builder(coll.size());
+        builder.add(coll);
+        const IndexedDB<AndAll<vector_facade>> db(coll, builder.capture());
+        check_db(db, coll);
+
+        // the threshold is met by rows with most of trigrams
+        QueryPlanner<AndAll<vector_facade>> planner(db.get_index());
+        const vector_facade* result = nullptr;
+        assert(planner.candidates(fuzzy_query("warszawa", 1).children()[0], result));
+        assert(result != nullptr && result->cardinality() <= 6);
+    }
+
+    {
+        Builder<bitvector_compressed> builder(coll.size());
+        builder.add(coll);
+        check_db(IndexedDB<CostBased<bitvector_compressed>>(coll, builder.capture()), coll);
+    }
+
+    {
+        ThreadPool pool(2);
+        check_db(ShardedDB<AndAll<vector_facade>>(coll, pool, 500), coll);
+    }
+
+    {
+        LiveDB<AndAll<bitvector_naive>> db(300);
+        for (const auto row: coll) {
+            db.insert(row);
+        }
+
+        check_db(db, coll);
+    }
+}
+
+
+int main() {
+    test();
+
+    puts("All OK");
+    return EXIT_SUCCESS;
+}
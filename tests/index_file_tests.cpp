@@ -0,0 +1,153 @@
+#include <vector>
+#include <string>
+#include <optional>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef ROARING
+#   include <roaring.c>
+#endif
+
+#include "Builder.h"
+#include "DB.h"
+#include "NaiveDB.h"
+#include "IndexedDB.h"
+#include "IndexFile.h"
+#include "combiner/all.h"
+
+#include "bitvector_naive.h"
+#include "bitvector_tracking.h"
+#include "vector_facade.h"
+#ifdef ROARING
+#   include "roaring_facade.h"
+#endif
+
+#include "common.h"
+
+const char* path = "index_file_tests.tmp";
+
+
+Collection sample_collection() {
+    return sample_collection(1000, {"warszawa", "wroclaw", "krakow", "gdansk", "poznan", "lodz", "szczecin", "ab", ""});
+}
+
+
+template <typename BITVECTOR>
+std::vector<size_t> items(const BITVECTOR& bv) {
+    std::vector<size_t> result;
+    bv.visit([&result](size_t index) {
+        result.push_back(index);
+    });
+
+    return result;
+}
+
+
+template <typename BITVECTOR>
+void test_round_trip() {
+    const Collection coll = sample_collection();
+
+    Builder<BITVECTOR> builder(coll.size());
+    builder.add(coll);
+    const auto index = builder.capture();
+
+    save_index(index, path);
+    const auto mapped = open_index<BITVECTOR>(path);
+
+    assert(mapped.size() == index.size());
+    for (size_t i=0; i < index.size(); i++) {
+        const uint32_t trigram = index.trigrams[i];
+        const auto* item = mapped.find(trigram);
+        assert(item != nullptr);
+        assert(item->get_cardinality() == index.items[i].get_cardinality());
+        assert(item->bv.cardinality() == index.items[i].bv.cardinality());
+        assert(items(item->bv) == items(index.items[i].bv));
+    }
+
+    assert(mapped.find(0x7a7a7a) == nullptr); // "zzz"
+
+    // in-place operations copy mapped data first
+    {
+        auto mapped_copy = open_index<BITVECTOR>(path);
+        const auto* a = index.find(Index<BITVECTOR>::trigram("row", 0));
+        const auto* b = index.find(Index<BITVECTOR>::trigram("w 1", 0));
+        auto* ma = mapped_copy.find(Index<BITVECTOR>::trigram("row", 0));
+        auto* mb = mapped_copy.find(Index<BITVECTOR>::trigram("w 1", 0));
+
+        BITVECTOR expected = BITVECTOR::bit_and(a->bv, b->bv).value();
+        BITVECTOR v = std::move(ma->bv);
+        assert(BITVECTOR::bit_and_inplace(v, mb->bv));
+        assert(items(v) == items(expected));
+
+        BITVECTOR w = std::move(mb->bv);
+        BITVECTOR::bit_or_inplace(w, a->bv);
+        assert(items(w) == items(a->bv));
+    }
+
+    IndexedDB<AndAll<BITVECTOR>> db(coll, open_index<BITVECTOR>(path));
+    NaiveDB naive(coll);
+    check_words(db, naive, std::vector<std::string_view>{"wars", "row 1", "row 79", "aw", "cin", "zzz", "row 999"}, true);
+
+    std::remove(path);
+}
+
+
+void test_invalid_file() {
+    FILE* f = fopen(path, "wb");
+    fputs("definitely not an index", f);
+    fclose(f);
+
+    bool thrown = false;
+    try {
+        open_index<bitvector_naive>(path);
+    } catch (std::runtime_error&) {
+        thrown = true;
+    }
+
+    assert(thrown);
+    std::remove(path);
+}
+
+
+void test_wrong_bitvector_type() {
+    const Collection coll = sample_collection();
+
+    Builder<bitvector_naive> builder(coll.size());
+    builder.add(coll);
+    save_index(builder.capture(), path);
+
+    bool thrown = false;
+    try {
+        open_index<vector_facade>(path);
+    } catch (std::runtime_error&) {
+        thrown = true;
+    }
+
+    assert(thrown);
+    std::remove(path);
+}
+
+
+void test() {
+    test_round_trip<bitvector_naive>();
+    test_round_trip<bitvector_tracking>();
+    test_round_trip<vector_facade>();
+#ifdef ROARING
+    // the portable format is deserialized, see roaring_facade::view
+    test_round_trip<roaring_facade>();
+#endif
+
+    test_invalid_file();
+    test_wrong_bitvector_type();
+}
+
+
+int main() {
+    test();
+
+    puts("All OK");
+    return EXIT_SUCCESS;
+}
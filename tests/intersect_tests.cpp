@@ -0,0 +1,142 @@
+#include <vector>
+#include <optional>
+#include <random>
+#include <algorithm>
+#include <iterator>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "vector_facade.h"
+
+
+std::vector<uint32_t> random_list(std::mt19937& random, size_t n, uint32_t max) {
+    std::uniform_int_distribution<uint32_t> value(0, max);
+
+    std::vector<uint32_t> list;
+    for (size_t i=0; i < n; i++) {
+        list.push_back(value(random));
+    }
+
+    std::sort(list.begin(), list.end());
+    list.erase(std::unique(list.begin(), list.end()), list.end());
+
+    return list;
+}
+
+
+index_range as_range(const std::vector<uint32_t>& list) {
+    return {list.data(), list.data() + list.size()};
+}
+
+
+std::vector<uint32_t> expected_intersection(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+    std::vector<uint32_t> result;
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+
+    return result;
+}
+
+
+void test_kernel(intersect_inplace_fn kernel) {
+    std::mt19937 random(0);
+
+    for (size_t n=0; n < 200; n += 7) {
+        for (size_t m: {0, 1, 5, 8, 9, 50, 300, 5000}) {
+            const auto a = random_list(random, n, 1000);
+            const auto b = random_list(random, m, 1000);
+
+            std::vector<uint32_t> out = a;
+            out.resize(kernel(out.data(), out.size(), as_range(b)));
+
+            assert(out == expected_intersection(a, b));
+        }
+    }
+}
+
+
+void test_kernels() {
+    test_kernel(intersect_inplace_scalar);
+    test_kernel(intersect_inplace_galloping);
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        test_kernel(intersect_inplace_avx2);
+    }
+#endif
+}
+
+
+void test_intersect_many() {
+    std::mt19937 random(0);
+
+    for (size_t k=1; k < 6; k++) {
+        for (int trial=0; trial < 50; trial++) {
+            std::vector<std::vector<uint32_t>> lists;
+            for (size_t i=0; i < k; i++) {
+                const size_t n = (i == 1) ? 10 : 2000 + 1000 * i;
+                lists.push_back(random_list(random, n, 10000));
+            }
+
+            std::vector<index_range> ranges;
+            std::vector<uint32_t> expected = lists[0];
+            for (const auto& list: lists) {
+                ranges.push_back(as_range(list));
+                expected = expected_intersection(expected, list);
+            }
+
+            std::vector<uint32_t> out(lists[0].size());
+            out.resize(intersect_many(ranges.data(), k, out.data()));
+            assert(out == expected);
+        }
+    }
+}
+
+
+void test_bit_and_many() {
+    vector_facade bv1(100);
+    vector_facade bv2(100);
+    vector_facade bv3(100);
+
+    for (size_t i=0; i < 100; i += 2) {
+        bv1.set(i);
+    }
+
+    for (size_t i=0; i < 100; i += 3) {
+        bv2.set(i);
+    }
+
+    for (size_t i=0; i < 100; i += 5) {
+        bv3.set(i);
+    }
+
+    const vector_facade* inputs[] = {&bv1, &bv2, &bv3};
+    const auto result = vector_facade::bit_and_many(inputs, 3);
+    assert(result.has_value());
+
+    std::vector<uint32_t> items;
+    result->visit([&items](uint32_t index) {
+        items.push_back(index);
+    });
+    assert((items == std::vector<uint32_t>{0, 30, 60, 90}));
+
+    vector_facade empty(100);
+    const vector_facade* inputs2[] = {&bv1, &empty};
+    assert(!vector_facade::bit_and_many(inputs2, 2).has_value());
+}
+
+
+void test() {
+    test_kernels();
+    test_intersect_many();
+    test_bit_and_many();
+}
+
+
+int main() {
+    test();
+
+    puts("All OK");
+    return EXIT_SUCCESS;
+}
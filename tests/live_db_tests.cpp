@@ -0,0 +1,310 @@
+#include <vector>
+#include <string>
+#include <optional>
+#include <map>
+#include <thread>
+#include <atomic>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "DB.h"
+#include "LiveDB.h"
+#include "combiner/all.h"
+
+#include "bitvector_naive.h"
+#include "vector_facade.h"
+#include "vector16_facade.h"
+
+
+const std::vector<std::string_view> queries = {
+    "", "1", "12", "row", "row 1", "ow 12", "9 1", "123", "0 0", "77", "xyz", " 5", "  "
+};
+
+
+int expected_matches(const std::map<size_t, std::string>& rows, std::string_view word) {
+    int n = 0;
+    for (const auto& row: rows) {
+        n += (row.second.find(word) != std::string::npos);
+    }
+
+    return n;
+}
+
+
+template <typename DBTYPE>
+void check(const DBTYPE& db, const std::map<size_t, std::string>& rows) {
+    assert(db.size() == rows.size());
+    for (const auto& word: queries) {
+        assert(db.matches(word) == expected_matches(rows, word));
+    }
+}
+
+
+template <typename DBTYPE>
+void test_updates(size_t delta_limit) {
+    DBTYPE db(delta_limit);
+    std::map<size_t, std::string> rows;
+
+    check(db, rows);
+    assert(!db.compact());
+    assert(!db.remove(0));
+
+    srand(delta_limit);
+    for (size_t step=0; step < 3000; step++) {
+        const int op = rand() % 10;
+        if (op < 6 || rows.empty()) {
+            const std::string row = "row " + std::to_string(rand() % 2000) + " " + std::to_string(step % 13);
+            const size_t id = db.insert(row);
+            assert(rows.count(id) == 0);
+            rows[id] = row;
+        } else if (op < 9) {
+            auto it = rows.begin();
+            std::advance(it, rand() % rows.size());
+            assert(db.remove(it->first));
+            assert(!db.remove(it->first));
+            rows.erase(it);
+        } else {
+            db.compact();
+        }
+
+        if (step % 250 == 0) {
+            check(db, rows);
+        }
+    }
+
+    check(db, rows);
+    db.wait_for_worker();
+    db.compact();
+    assert(db.snapshot()->segments_count() <= 2);
+    check(db, rows);
+
+    // delete everything
+    for (const auto& row: rows) {
+        assert(db.remove(row.first));
+    }
+    rows.clear();
+    check(db, rows);
+    db.compact();
+    check(db, rows);
+}
+
+
+void test_snapshot() {
+    LiveDB<AndAll<vector_facade>> db(4);
+
+    const size_t a = db.insert("warszawa");
+    db.insert("warka");
+    db.insert("wawer");
+    db.insert("krakow");
+    db.insert("wroclaw");
+
+    const auto snapshot = db.snapshot();
+    assert(snapshot->matches("war") == 2);
+
+    db.remove(a);
+    db.insert("warta");
+    db.compact();
+
+    assert(snapshot->matches("war") == 2);
+    assert(snapshot->size() == 5);
+    assert(db.matches("war") == 2);
+    assert(db.matches("warsz") == 0);
+    assert(db.size() == 5);
+}
+
+
+void test_automatic_merge() {
+    LiveDB<AndAll<vector_facade>> db(16);
+
+    // segments are merged like a binary counter
+    for (size_t i=0; i < 16 * 100; i++) {
+        db.insert("row " + std::to_string(i));
+        db.wait_for_worker();
+
+        const size_t frozen = (i + 1) / 16;
+        size_t bits = 0;
+        for (size_t k=frozen; k > 0; k /= 2) {
+            bits += k % 2;
+        }
+        assert(db.snapshot()->segments_count() == bits + 1);
+    }
+
+    std::vector<size_t> expected;
+    for (size_t i=0; i < 16 * 100; i++) {
+        if (("row " + std::to_string(i)).find("w 15") != std::string::npos) {
+            expected.push_back(i);
+        }
+    }
+
+    assert(db.find_rows("w 15") == expected);
+    assert(db.matches("w 15") == int(expected.size()));
+}
+
+
+// 16-bit ids: merged segments have at most 64K rows.
+void test_segment_size_limit() {
+    using DBTYPE = LiveDB<AndAll<vector16_facade>>;
+    static_assert(DBTYPE::max_segment_size == 65536);
+
+    const size_t delta_limit = DBTYPE::max_segment_size / 4;
+    DBTYPE db(delta_limit);
+    for (size_t i=0; i < 6 * delta_limit; i++) {
+        db.insert("row " + std::to_string(i));
+    }
+    db.wait_for_worker();
+
+    // 4 + 2, and they can't be compacted
+    assert(db.snapshot()->segments_count() == 3);
+    assert(!db.compact());
+
+    assert(db.matches("row 6553") == 11);
+    assert(db.find_rows("row 98303") == std::vector<size_t>({98303}));
+}
+
+
+// vector_facade whose set() waits while `paused`, thus a test can hold
+// the worker in the middle of building an index.
+struct paused_facade: vector_facade {
+    static inline std::atomic<bool> paused{false};
+
+    using vector_facade::vector_facade;
+
+    paused_facade(vector_facade&& bv)
+        : vector_facade(std::move(bv)) {}
+
+    void set(size_t index) {
+        while (paused) {
+            std::this_thread::yield();
+        }
+
+        vector_facade::set(index);
+    }
+
+    static std::optional<paused_facade> bit_and(const paused_facade& a, const paused_facade& b) {
+        auto result = vector_facade::bit_and(a, b);
+        if (!result.has_value()) {
+            return std::nullopt;
+        }
+
+        return paused_facade(std::move(*result));
+    }
+};
+
+
+// Filling the delta segment doesn't wait for its index.
+void test_background_worker() {
+    LiveDB<AndAll<paused_facade>> db(16);
+
+    paused_facade::paused = true;
+    for (size_t i=0; i < 16 * 4; i++) {
+        db.insert("row " + std::to_string(i));
+    }
+
+    // full delta segments are scanned meanwhile
+    assert(db.snapshot()->segments_count() == 5);
+    assert(db.matches("row 1") == 11);
+    assert(!db.compact());
+
+    paused_facade::paused = false;
+    db.wait_for_worker();
+
+    assert(db.snapshot()->segments_count() == 2);
+    assert(db.matches("row 1") == 11);
+    assert(db.find_rows("w 63") == std::vector<size_t>({63}));
+}
+
+
+void test_concurrent_readers() {
+    LiveDB<AndAll<vector_facade>> db(64);
+
+    std::atomic<bool> stop{false};
+    auto reader = [&db, &stop] {
+        while (!stop) {
+            const auto snapshot = db.snapshot();
+            // every row contains the empty string
+            assert(snapshot->matches("") == int(snapshot->size()));
+            assert(snapshot->matches("row") == int(snapshot->size()));
+        }
+    };
+
+    std::thread r1(reader);
+    std::thread r2(reader);
+    std::thread compaction([&db, &stop] {
+        while (!stop) {
+            db.compact();
+        }
+    });
+
+    std::vector<size_t> ids;
+    for (size_t i=0; i < 2000; i++) {
+        ids.push_back(db.insert("row " + std::to_string(i)));
+        if (i % 3 == 0) {
+            assert(db.remove(ids[i / 2]));
+        }
+    }
+
+    stop = true;
+    r1.join();
+    r2.join();
+    compaction.join();
+}
+
+
+void test_invalid_delta_limit() {
+    try {
+        LiveDB<AndAll<vector_facade>> db(0);
+        assert(false);
+    } catch (std::invalid_argument&) {
+        // ok
+    }
+
+    try {
+        LiveDB<AndAll<vector16_facade>> db(65537);
+        assert(false);
+    } catch (std::invalid_argument&) {
+        // ok
+    }
+}
+
+
+void test_null_character() {
+    LiveDB<AndAll<vector_facade>> db(1);
+    db.insert("ab");
+
+    try {
+        db.insert(std::string_view("a\0b", 3));
+        assert(false);
+    } catch (std::invalid_argument&) {
+        // ok
+    }
+
+    assert(db.size() == 1);
+    assert(db.matches(std::string_view("ab\0", 3)) == 0);
+}
+
+
+void test() {
+    test_invalid_delta_limit();
+    test_null_character();
+    test_snapshot();
+
+    test_updates<LiveDB<AndAll<vector_facade>>>(1);
+    test_updates<LiveDB<AndAll<vector_facade>>>(16);
+    test_updates<LiveDB<CostBased<vector_facade>>>(100);
+    test_updates<LiveDB<AndAll<bitvector_naive>>>(50);
+
+    test_automatic_merge();
+    test_segment_size_limit();
+    test_background_worker();
+    test_concurrent_readers();
+}
+
+
+int main() {
+    test();
+
+    puts("All OK");
+    return EXIT_SUCCESS;
+}
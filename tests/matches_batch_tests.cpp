@@ -0,0 +1,69 @@
+#include <vector>
+#include <string>
+#include <optional>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Builder.h"
+#include "DB.h"
+#include "NaiveDB.h"
+#include "IndexedDB.h"
+#include "combiner/all.h"
+
+#include "bitvector_naive.h"
+#include "vector_facade.h"
+
+#include "common.h"
+
+
+Collection sample_collection() {
+    Collection coll;
+    coll.emplace_back("warszawa");
+    coll.emplace_back("wroclaw");
+    coll.emplace_back("krakow");
+    coll.emplace_back("gdansk");
+    coll.emplace_back("poznan");
+    coll.emplace_back("szczecin");
+    coll.emplace_back("bydgoszcz");
+    coll.emplace_back("lublin");
+    coll.emplace_back("warka");
+    coll.emplace_back("wawer");
+
+    return coll;
+}
+
+
+const std::vector<std::string_view> queries = {
+    "wa", "war", "warszawa", "arsz", "krakow", "w", "", "szcz", "war",
+    "lin", "xyz", "warszawa", "zzzz", "ow", "wroclaw", "aw", "warka"
+};
+
+
+template <typename DBTYPE>
+void test_db() {
+    const Collection coll = sample_collection();
+
+    Builder<typename DBTYPE::bitvector_type> builder(coll.size());
+    builder.add(coll);
+    const DBTYPE db(coll, builder.capture());
+
+    const NaiveDB naive(coll);
+    check_words(db, naive, queries, true);
+}
+
+
+void test() {
+    test_db<IndexedDB<AndAll<bitvector_naive>>>();
+    test_db<IndexedDB<CostBased<vector_facade>>>();
+    test_db<IndexedDB<PickCheapest<vector_facade>>>();
+}
+
+
+int main() {
+    test();
+
+    puts("All OK");
+    return EXIT_SUCCESS;
+}
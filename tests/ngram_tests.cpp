@@ -0,0 +1,184 @@
+#include <vector>
+#include <string>
+#include <optional>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Builder.h"
+#include "BulkBuilder.h"
+#include "DB.h"
+#include "NaiveDB.h"
+#include "IndexedDB.h"
+#include "IndexFile.h"
+#include "combiner/all.h"
+
+#include "bitvector_naive.h"
+#include "bitvector_compressed.h"
+#include "vector_facade.h"
+
+#include "common.h"
+
+const char* path = "ngram_tests.tmp";
+
+
+// Generated rows share suffixes, so "ing" and " sing" are frequent too.
+Collection sample_collection() {
+    Collection coll;
+    coll.emplace_back("warszawa");
+    coll.emplace_back("wroclaw");
+    coll.emplace_back("singing");
+    coll.emplace_back("ring");
+    coll.emplace_back("ab");
+    coll.emplace_back("");
+    for (int i=0; i < 500; i++) {
+        coll.emplace_back("row " + std::to_string(i * 7919) + (i % 3 == 0 ? " ing" : " sing"));
+    }
+
+    return coll;
+}
+
+
+const std::vector<std::string_view> queries = {
+    "row ", "row 1", "ow 7", "w 79", "ing", "sing", " sing", "ring", "singing", "ow ",
+    "row 7919 ing", "row 7919 sing", "9 sing", "8 ing", "wars", "xing", "row x", "ab", "",
+};
+
+
+template <typename DBTYPE>
+void check_db(const DBTYPE& db, const NaiveDB& naive) {
+    assert(db.get_index().frequent_cardinality > 0);
+
+    check_words(db, naive, queries, true);
+
+    for (const auto word: queries) {
+        assert(db.count(Query::term(word) && !Query::term("ab")) == naive.count(Query::term(word) && !Query::term("ab")));
+    }
+}
+
+
+template <typename BITVECTOR>
+void test_builder() {
+    using DBTYPE = IndexedDB<AndAll<BITVECTOR>>;
+    using index_type = Index<BITVECTOR>;
+
+    const Collection coll = sample_collection();
+    const NaiveDB naive(coll);
+
+    BuilderOptions options;
+    options.frequent_trigrams = 4;
+
+    {
+        Builder<BITVECTOR> builder(coll.size(), options);
+        builder.add(coll);
+        const DBTYPE db(coll, builder.capture());
+        check_db(db, naive);
+
+        // "row" and "ow " occur in each generated row, "row " is the 4-gram
+        const auto& index = db.get_index();
+        const auto* item = index.find(index_type::ngram_key("row ", 0));
+        assert(item != nullptr && item->get_cardinality() == 500);
+
+        // a trigram with the null character is not taken as a 4-gram
+        const uint32_t key = index_type::ngram_key("row ", 0);
+        const char word[] = {char(key & 0xff), '\0', char(key >> 16)};
+        assert(db.matches(std::string_view(word, 3)) == 0);
+        assert(index.cheapest("row 1")->get_cardinality() < 500);
+
+        // " 79" is rare, its postings are selective enough
+        assert(index.find(index_type::ngram_key("w 79", 1)) == nullptr);
+    }
+
+    {
+        Builder<BITVECTOR> builder(coll.size(), options);
+        builder.add(coll, 3);
+        check_db(DBTYPE(coll, builder.capture()), naive);
+    }
+
+    {
+        BulkBuilder<BITVECTOR> builder(coll.size(), options);
+        builder.add(coll);
+        check_db(DBTYPE(coll, builder.capture()), naive);
+    }
+
+    // not enabled by default
+    Builder<BITVECTOR> builder(coll.size());
+    builder.add(coll);
+    const auto index = builder.capture();
+    assert(index.frequent_cardinality == 0);
+    assert(index.find(index_type::ngram_key("row ", 0)) == nullptr);
+}
+
+
+void test_query_keys() {
+    using index_type = Index<vector_facade>;
+
+    const Collection coll = sample_collection();
+
+    BuilderOptions options;
+    options.frequent_trigrams = 2;
+
+    Builder<vector_facade> builder(coll.size(), options);
+    builder.add(coll);
+    const index_type index = builder.capture();
+
+    auto keys = [&index](std::string_view word) {
+        std::vector<uint32_t> result;
+        index.visit_query_keys(word, [&result](uint32_t key) {
+            result.push_back(key);
+        });
+
+        return result;
+    };
+
+    assert(keys("row ") == std::vector<uint32_t>({index_type::ngram_key("row ", 0), index_type::trigram("row ", 1)}));
+    assert(keys("row") == std::vector<uint32_t>({index_type::trigram("row", 0)}));
+    assert(keys("xrow") == std::vector<uint32_t>({index_type::trigram("xrow", 0), index_type::trigram("xrow", 1)}));
+    assert(keys("row 1") == std::vector<uint32_t>({index_type::ngram_key("row 1", 0), index_type::ngram_key("row 1", 1), index_type::trigram("row 1", 2)}));
+
+    for (const auto row: coll) {
+        index.visit_ngram_keys(row, [](uint32_t key) {
+            assert(!index_type::is_trigram(key));
+        });
+    }
+}
+
+
+void test_index_file() {
+    using DBTYPE = IndexedDB<AndAll<vector_facade>>;
+
+    const Collection coll = sample_collection();
+    const NaiveDB naive(coll);
+
+    BuilderOptions options;
+    options.frequent_trigrams = 4;
+
+    Builder<vector_facade> builder(coll.size(), options);
+    builder.add(coll);
+    const auto index = builder.capture();
+    save_index(index, path);
+
+    const DBTYPE db(coll, open_index<vector_facade>(path));
+    assert(db.get_index().frequent_cardinality == index.frequent_cardinality);
+    check_db(db, naive);
+    std::remove(path);
+}
+
+
+void test() {
+    test_builder<vector_facade>();
+    test_builder<bitvector_naive>();
+    test_builder<bitvector_compressed>();
+
+    test_query_keys();
+    test_index_file();
+}
+
+
+int main() {
+    test();
+
+    puts("All OK");
+    return EXIT_SUCCESS;
+}
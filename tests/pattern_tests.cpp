@@ -0,0 +1,203 @@
+#include <vector>
+#include <string>
+#include <optional>
+#include <regex>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Builder.h"
+#include "DB.h"
+#include "NaiveDB.h"
+#include "IndexedDB.h"
+#include "QueryPlanner.h"
+#include "ShardedDB.h"
+#include "LiveDB.h"
+#include "Pattern.h"
+#include "combiner/all.h"
+
+#include "bitvector_naive.h"
+#include "vector_facade.h"
+
+#include "common.h"
+
+
+Collection sample_collection() {
+    return sample_collection(2000, {"london", "londonderry", "new london", "100% cotton", "a_b", "axb", ""});
+}
+
+
+const std::vector<std::string> like_patterns = {
+    "london", "london%", "%london", "%london%", "%on%on%", "l_nd_n%", "%row 1__ 1%",
+    "%100\\% %", "a\\_b", "a_b", "%", "", "_", "%row%7%0%", "%xyz%", "%ow 12% 3",
+};
+
+
+const std::vector<std::string> regex_patterns = {
+    "london", "^london$", "lon(don|g)", "row 1[0-3]+ 5", "row (12|34)\\d* 1[12]",
+    "(abc|row 9).*7$", "ro?w 8", "[^a-z]77", "w \\d{4} 0", "l.nd.n", "(?:ond)+erry",
+    "(x|y)*", "", ".", "row (1|2|3|4|5|6|7|8|9)(0|1|2|3|4|5|6|7|8|9)7", "\\bnew\\b",
+    "(on)\\1", "a\\x5fb", "row 5(?=0)", "[[:digit:]]{3} 1", "[.]", "row 99?9",
+};
+
+
+// the row matches whole the pattern
+bool like_reference(std::string_view pattern, std::string_view row) {
+    std::string re;
+    for (size_t i=0; i < pattern.size(); i++) {
+        const char c = pattern[i];
+        if (c == '%') {
+            re += ".*";
+        } else if (c == '_') {
+            re += ".";
+        } else {
+            const char literal = (c == '\\' && i + 1 < pattern.size()) ? pattern[++i] : c;
+            re += '[';
+            re += literal;
+            re += ']';
+        }
+    }
+
+    return std::regex_match(row.begin(), row.end(), std::regex(re));
+}
+
+
+std::vector<Query> sample_queries() {
+    std::vector<Query> queries;
+    for (const auto& p: like_patterns) {
+        queries.push_back(like_query(p));
+    }
+
+    for (const auto& p: regex_patterns) {
+        queries.push_back(regex_query(p));
+    }
+
+    // patterns are a part of boolean queries
+    queries.push_back(regex_query("row 1.*3") && !like_query("% 3"));
+    queries.push_back(like_query("%london") || regex_query("row 5+ 0"));
+
+    return queries;
+}
+
+
+void check_db(const DB& db, const Collection& coll) {
+    check_queries(db, coll, sample_queries());
+}
+
+
+void test_like() {
+    const Collection coll = sample_collection();
+    for (const auto& p: like_patterns) {
+        const like_matcher matcher(p);
+        for (const auto row: coll) {
+            assert(matcher(row) == like_reference(p, row));
+        }
+    }
+
+    assert(like_matcher("%on%on%").literals() == std::vector<std::string>({"on", "on"}));
+    assert(like_matcher("l_nd_n%").literals() == std::vector<std::string>({"l", "nd", "n"}));
+    assert(like_matcher("%100\\%_x").literals() == std::vector<std::string>({"100%", "x"}));
+    assert(like_matcher("%").literals().empty());
+}
+
+
+// The required query is a necessary condition.
+void test_regex_required() {
+    const Collection coll = sample_collection();
+    for (const auto& p: regex_patterns) {
+        const std::regex re(p);
+        const Query required = regex_analyzer::required(p);
+        for (const auto row: coll) {
+            if (std::regex_search(row.begin(), row.end(), re)) {
+                assert(required.matches(row));
+            }
+        }
+    }
+
+    auto rows_of = [&coll](const Query& query) {
+        return expected_rows(coll, query).size();
+    };
+
+    // literals are not split by other subexpressions
+    const Query q = regex_analyzer::required("lon.*derry");
+    assert(rows_of(q) == 1);
+    assert(!q.matches("lon der ry"));
+
+    // small sets of strings are expanded
+    assert(regex_analyzer::required("lo(n|ndon)d").matches("lond"));
+    assert(!regex_analyzer::required("lo(n|ndon)d").matches("lo nd"));
+    assert(!regex_analyzer::required("row [12]3").matches("row 3"));
+}
+
+
+// Patterns with a literal run of 3 characters are narrowed by the index.
+void test_plan() {
+    const Collection coll = sample_collection();
+
+    Builder<vector_facade> builder(coll.size());
+    builder.add(coll);
+    const auto index = builder.capture();
+
+    auto narrowed = [&index](const Query& query) {
+        const vector_facade* result = nullptr;
+        return QueryPlanner<AndAll<vector_facade>>(index).candidates(query, result);
+    };
+
+    assert(narrowed(like_query("%london%")));
+    assert(narrowed(like_query("l_nd%rry")));
+    assert(narrowed(regex_query("lon.*derry")));
+    assert(narrowed(regex_query("\\d+ (123|456)")));
+    assert(narrowed(regex_query("row [0-5]")));
+
+    assert(!narrowed(like_query("%on%on%")));
+    assert(!narrowed(regex_query("(x|y)*")));
+    assert(!narrowed(regex_query("[[:digit:]]{3} 1")));
+}
+
+
+void test() {
+    test_like();
+    test_regex_required();
+    test_plan();
+
+    const Collection coll = sample_collection();
+    check_db(NaiveDB(coll), coll);
+
+    {
+        Builder<vector_facade> builder(coll.size());
+        builder.add(coll);
+        check_db(IndexedDB<AndAll<vector_facade>>(coll, builder.capture()), coll);
+    }
+
+    {
+        BuilderOptions options;
+        options.short_postings = true;
+
+        Builder<bitvector_naive> builder(coll.size(), options);
+        builder.add(coll);
+        check_db(IndexedDB<CostBased<bitvector_naive>>(coll, builder.capture()), coll);
+    }
+
+    {
+        ThreadPool pool(2);
+        check_db(ShardedDB<AndAll<vector_facade>>(coll, pool, 500), coll);
+    }
+
+    {
+        LiveDB<AndAll<vector_facade>> db(300);
+        for (const auto row: coll) {
+            db.insert(row);
+        }
+
+        check_db(db, coll);
+    }
+}
+
+
+int main() {
+    test();
+
+    puts("All OK");
+    return EXIT_SUCCESS;
+}
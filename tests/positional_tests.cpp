@@ -0,0 +1,74 @@
+#include <vector>
+#include <string>
+#include <optional>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Builder.h"
+#include "DB.h"
+#include "NaiveDB.h"
+#include "IndexedDB.h"
+#include "PositionalDB.h"
+#include "combiner/all.h"
+
+#include "bitvector_naive.h"
+#include "vector_facade.h"
+
+#include "common.h"
+
+
+const std::vector<std::string_view> queries = {
+    "abcd", "bcde", "cabc", "abcabc", "abcabca", "aaaa", "aaaaaa", "aaaaaaa",
+    "row 1", "ow 12", "w 123", "123 4", "99 1", "row 12 1", "row 1234 5", "w 77 12",
+    "1 1", "xyzw", "abc", "row", "a", "", "row 100 1",
+};
+
+
+void test_occurrences() {
+    Collection coll;
+    coll.emplace_back("abcabc");
+    coll.emplace_back("xabc");
+    coll.emplace_back("aaaa");
+
+    const PositionalIndex index(coll);
+
+    // rows start at 0, 7 and 12
+    assert(index.occurrences("abca") == std::vector<uint32_t>({0}));
+    assert(index.occurrences("abc") == std::vector<uint32_t>({0, 3, 8}));
+    assert(index.occurrences("aaa") == std::vector<uint32_t>({12, 13}));
+    assert(index.occurrences("aaaa") == std::vector<uint32_t>({12}));
+    assert(index.occurrences("aaaaa").empty());
+    assert(index.occurrences("bcx").empty());
+    assert(index.occurrences("bcxa").empty());
+
+    assert(index.count("abc") == 2);
+    assert(index.count("aaa") == 1);
+}
+
+
+void test() {
+    test_occurrences();
+
+    const Collection coll = sample_collection(3000, {"abc", "def", "aaaaaa", "abcabcabc", "", "ab", "cde abd bcd"});
+    const NaiveDB naive(coll);
+
+    Builder<vector_facade> builder(coll.size());
+    builder.add(coll);
+    const PositionalDB<AndAll<vector_facade>> db(coll, builder.capture());
+
+    check_words(db, naive, queries, true);
+
+    // boolean queries use the trigram index
+    assert(db.count(Query::term("row 1") && !Query::term("row 12")) == naive.count(Query::term("row 1") && !Query::term("row 12")));
+    assert(db.get_positional_index().size_in_bytes() > 0);
+}
+
+
+int main() {
+    test();
+
+    puts("All OK");
+    return EXIT_SUCCESS;
+}
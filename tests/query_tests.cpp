@@ -0,0 +1,210 @@
+#include <vector>
+#include <string>
+#include <optional>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Builder.h"
+#include "DB.h"
+#include "NaiveDB.h"
+#include "IndexedDB.h"
+#include "QueryPlanner.h"
+#include "IndexFile.h"
+#include "CachedDB.h"
+#include "ShardedDB.h"
+#include "LiveDB.h"
+#include "Query.h"
+#include "combiner/all.h"
+
+#include "bitvector_naive.h"
+#include "bitvector_compressed.h"
+#include "vector_facade.h"
+
+#include "common.h"
+
+const char* path = "query_tests.tmp";
+
+
+Query t(std::string_view text) {
+    return Query::term(text);
+}
+
+
+std::vector<Query> sample_queries() {
+    std::vector<Query> queries;
+    queries.push_back(t("row 1"));
+    queries.push_back(t("123") && t(" 5"));
+    queries.push_back(t("row 12") && t("34"));
+    queries.push_back(t("777") || t("888") || t("xyz"));
+    queries.push_back(t("row 9") && !t(" 0"));
+    queries.push_back(!t("row 1"));
+    queries.push_back(!t("xyz"));
+    queries.push_back(t("1") && t("2") && t("3"));
+    queries.push_back((t("row 1") || t("row 2")) && !(t("0") || t("5")));
+    queries.push_back((t("row 1") || t("7")) && t("xyz"));
+    queries.push_back(t("xyz") || !t("row"));
+    queries.push_back(t("") && t("99"));
+    queries.push_back(Query::all_of({}));
+    queries.push_back(Query::any_of({}));
+    queries.push_back(Query::all_of({t("row 3")}) && Query::any_of({t("44"), t("55")}));
+
+    return queries;
+}
+
+
+void check_db(const DB& db, const Collection& coll) {
+    check_queries(db, coll, sample_queries());
+}
+
+
+void test_query_matches() {
+    assert(t("abc").matches("xabcx"));
+    assert(!t("abc").matches("ab"));
+    assert(t("").matches(""));
+
+    assert((t("a") && t("b")).matches("ab"));
+    assert(!(t("a") && t("b")).matches("a"));
+    assert((t("a") || t("b")).matches("b"));
+    assert(!(t("a") || t("b")).matches("c"));
+    assert((!t("a")).matches("b"));
+    assert(Query::all_of({}).matches("x"));
+    assert(!Query::any_of({}).matches("x"));
+
+    // nested operators are flattened, a double negation is removed
+    const Query q = t("a") && t("b") && (t("c") && t("d"));
+    assert(q.get_kind() == Query::kind::all_of);
+    assert(q.children().size() == 4);
+    assert((t("a") || t("b") || t("c")).children().size() == 3);
+    assert((!!t("a")).get_kind() == Query::kind::term);
+}
+
+
+template <typename DBTYPE>
+void test_indexed(const Collection& coll, BuilderOptions options = BuilderOptions()) {
+    Builder<typename DBTYPE::bitvector_type> builder(coll.size(), options);
+    builder.add(coll);
+    const DBTYPE db(coll, builder.capture());
+
+    check_db(db, coll);
+}
+
+
+// bitvectors refer to the mapped file
+template <typename COMBINER>
+void test_mapped(const Collection& coll) {
+    using bitvector_type = typename COMBINER::bitvector_type;
+
+    Builder<bitvector_type> builder(coll.size());
+    builder.add(coll);
+    save_index(builder.capture(), path);
+
+    const IndexedDB<COMBINER> db(coll, open_index<bitvector_type>(path));
+    check_db(db, coll);
+
+    std::remove(path);
+}
+
+
+void test_plan() {
+    const Collection coll = sample_collection(3000);
+
+    Builder<vector_facade> builder(coll.size());
+    builder.add(coll);
+    const auto index = builder.capture();
+
+    QueryPlanner<AndAll<vector_facade>> planner(index);
+    auto candidates = [&planner](const Query& query, const vector_facade*& result) {
+        return planner.candidates(query, result);
+    };
+
+    const vector_facade* result = nullptr;
+
+    // no trigrams
+    assert(!candidates(t("12"), result));
+    assert(!candidates(!t("row 1"), result));
+    assert(!candidates(t("row") || t("1"), result));
+
+    // a missing trigram
+    assert(candidates(t("xyz") && t("row 1"), result));
+    assert(result == nullptr);
+    assert(candidates(t("xyz") || t("qqq"), result));
+    assert(result == nullptr);
+
+    // a single key, also repeated, is its posting list
+    const vector_facade* posting = &index.find(index.trigram("row", 0))->bv;
+    assert(candidates(t("row"), result));
+    assert(result == posting);
+    assert(candidates(t("row") && t("row"), result));
+    assert(result == posting);
+
+    // trigrams of all terms are intersected, a negation is left to the verification
+    const Query query = t("row 1") && !t("2") && t("0 0");
+    assert(candidates(query, result));
+    assert(result != nullptr);
+
+    std::vector<size_t> rows;
+    result->visit([&rows](size_t row) {
+        rows.push_back(row);
+    });
+
+    const auto expected = expected_rows(coll, t("row 1") && t("0 0"));
+    assert(rows.size() >= expected.size());
+    assert(std::includes(rows.begin(), rows.end(), expected.begin(), expected.end()));
+}
+
+
+void test() {
+    const Collection coll = sample_collection(3000);
+
+    test_query_matches();
+    test_plan();
+
+    check_db(NaiveDB(coll), coll);
+
+    test_indexed<IndexedDB<AndAll<vector_facade>>>(coll);
+    test_indexed<IndexedDB<PickCheapest<vector_facade>>>(coll);
+    test_indexed<IndexedDB<CostBased<bitvector_naive>>>(coll);
+    test_indexed<IndexedDB<AndAll<bitvector_compressed>>>(coll);
+    test_indexed<IndexedDB<AndAll<vector_facade>>>(coll, {true});
+    test_indexed<CachedDB<AndAll<vector_facade>>>(coll);
+
+    test_mapped<PickCheapest<vector_facade>>(coll);
+    test_mapped<AndAll<vector_facade>>(coll);
+    test_mapped<AndAll<bitvector_naive>>(coll);
+
+    {
+        ThreadPool pool(2);
+        const ShardedDB<AndAll<vector_facade>> db(coll, pool, 700);
+        check_db(db, coll);
+    }
+
+    {
+        LiveDB<AndAll<vector_facade>> db(500);
+        for (const auto row: coll) {
+            db.insert(row);
+        }
+
+        check_db(db, coll);
+
+        for (size_t i=0; i < coll.size(); i += 3) {
+            db.remove(i);
+        }
+
+        for (const auto& query: sample_queries()) {
+            for (const size_t row: db.find_rows(query)) {
+                assert(row % 3 != 0);
+                assert(query.matches(coll[row]));
+            }
+        }
+    }
+}
+
+
+int main() {
+    test();
+
+    puts("All OK");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+#include <vector>
+#include <string>
+#include <optional>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "DB.h"
+#include "NaiveDB.h"
+#include "ShardedDB.h"
+#include "combiner/all.h"
+
+#include "bitvector_naive.h"
+#include "vector_facade.h"
+#include "vector16_facade.h"
+
+#include "common.h"
+
+
+const std::vector<std::string_view> queries = {
+    "", "1", "12", "row", "row 1", "ow 12", "9 1", "123", "0 0", "77", "xyz", "row 5000 5", "  "
+};
+
+
+template <typename DBTYPE>
+void test_db(size_t rows, size_t segment_size, size_t threads) {
+    const Collection coll = sample_collection(rows);
+    const NaiveDB naive(coll);
+
+    ThreadPool pool(threads);
+    const DBTYPE db(coll, pool, segment_size);
+    assert(db.segments_count() == (rows + segment_size - 1) / segment_size);
+
+    check_words(db, naive, queries);
+}
+
+
+template <typename DBTYPE>
+void test_db() {
+    test_db<DBTYPE>(0, 100, 1);
+    test_db<DBTYPE>(1, 100, 1);
+    test_db<DBTYPE>(1000, 1000, 2);
+    test_db<DBTYPE>(1000, 7, 3);
+    test_db<DBTYPE>(5000, 256, 4);
+    test_db<DBTYPE>(70000, DBTYPE::default_segment_size, 2);
+}
+
+
+void test_vector16_facade() {
+    vector16_facade a(1 << 16);
+    vector16_facade b(1 << 16);
+    for (size_t i=0; i < (1 << 16); i += 3) {
+        a.set(i);
+    }
+    for (size_t i=0; i < (1 << 16); i += 5) {
+        b.set(i);
+    }
+
+    const auto c = vector16_facade::bit_and(a, b);
+    assert(c.has_value());
+    assert(c->cardinality() == (65535 / 15) + 1);
+
+    std::vector<uint32_t> ids;
+    c->visit([&ids](uint32_t id) { ids.push_back(id); });
+    assert(ids.size() == c->cardinality());
+    for (size_t i=0; i < ids.size(); i++) {
+        assert(ids[i] == i * 15);
+    }
+
+    vector16_facade::bit_or_inplace(a, b);
+    assert(a.cardinality() == 21846 + 13108 - c->cardinality());
+    assert(a.size_in_bytes() < a.cardinality() * sizeof(uint32_t));
+}
+
+
+void test_invalid_segment_size() {
+    const Collection coll = sample_collection(10);
+    ThreadPool pool(1);
+
+    try {
+        ShardedDB<AndAll<vector_facade>> db(coll, pool, 0);
+        assert(false);
+    } catch (std::invalid_argument&) {
+        // ok
+    }
+
+    // ids of vector16_facade are 16-bit
+    try {
+        ShardedDB<AndAll<vector16_facade>> db(coll, pool, 65537);
+        assert(false);
+    } catch (std::invalid_argument&) {
+        // ok
+    }
+
+    const ShardedDB<AndAll<vector16_facade>> db(coll, pool, 65536);
+    assert(db.segments_count() == 1);
+}
+
+
+void test() {
+    test_vector16_facade();
+    test_invalid_segment_size();
+
+    test_db<ShardedDB<AndAll<vector_facade>>>();
+    test_db<ShardedDB<AndAll<vector16_facade>>>();
+    test_db<ShardedDB<CostBased<vector16_facade>>>();
+    test_db<ShardedDB<AndAll<bitvector_naive>>>();
+}
+
+
+int main() {
+    test();
+
+    puts("All OK");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+#include <vector>
+#include <string>
+#include <optional>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Builder.h"
+#include "BulkBuilder.h"
+#include "DB.h"
+#include "NaiveDB.h"
+#include "IndexedDB.h"
+#include "IndexFile.h"
+#include "combiner/all.h"
+
+#include "bitvector_naive.h"
+#include "bitvector_compressed.h"
+#include "vector_facade.h"
+
+#include "common.h"
+
+const char* path = "short_postings_tests.tmp";
+
+
+Collection sample_collection() {
+    return sample_collection(500, {"warszawa", "wroclaw", "aaaa", "ab", "b", "", "\xff\xfe"});
+}
+
+
+// all 1- and 2-character strings made of some characters; rows have no
+// null character, "a\0" must not be taken as "a"
+std::vector<std::string> short_queries() {
+    const std::string chars = std::string("abwrz 0179\xff\xfe") + '\0';
+
+    std::vector<std::string> queries;
+    for (const char c1: chars) {
+        queries.push_back(std::string(1, c1));
+        for (const char c2: chars) {
+            queries.push_back(std::string(1, c1) + c2);
+        }
+    }
+
+    return queries;
+}
+
+
+template <typename DBTYPE>
+void check_db(const DBTYPE& db, const NaiveDB& naive) {
+    assert(db.get_index().short_postings);
+
+    check_words(db, naive, short_queries(), true);
+    check_words(db, naive, std::vector<std::string_view>{"", "war", "wars", "row 1", "aaa", "aaaa", "aaaaa"}, true);
+}
+
+
+template <typename BITVECTOR>
+void test_builder() {
+    using DBTYPE = IndexedDB<AndAll<BITVECTOR>>;
+
+    const Collection coll = sample_collection();
+    const NaiveDB naive(coll);
+
+    BuilderOptions options;
+    options.short_postings = true;
+
+    {
+        Builder<BITVECTOR> builder(coll.size(), options);
+        builder.add(coll);
+        check_db(DBTYPE(coll, builder.capture()), naive);
+    }
+
+    {
+        Builder<BITVECTOR> builder(coll.size(), options);
+        builder.add(coll, 3);
+        check_db(DBTYPE(coll, builder.capture()), naive);
+    }
+
+    {
+        BulkBuilder<BITVECTOR> builder(coll.size(), options);
+        builder.add(coll);
+        check_db(DBTYPE(coll, builder.capture()), naive);
+    }
+
+    // not enabled by default
+    Builder<BITVECTOR> builder(coll.size());
+    builder.add(coll);
+    const auto index = builder.capture();
+    assert(!index.short_postings);
+    assert(index.find(Index<BITVECTOR>::short_key("a")) == nullptr);
+}
+
+
+void test_index_file() {
+    using DBTYPE = IndexedDB<AndAll<vector_facade>>;
+
+    const Collection coll = sample_collection();
+    const NaiveDB naive(coll);
+
+    BuilderOptions options;
+    options.short_postings = true;
+
+    Builder<vector_facade> builder(coll.size(), options);
+    builder.add(coll);
+    save_index(builder.capture(), path);
+
+    check_db(DBTYPE(coll, open_index<vector_facade>(path)), naive);
+    std::remove(path);
+}
+
+
+void test_null_character() {
+    Collection coll;
+    coll.emplace_back("ab");
+
+    try {
+        coll.emplace_back(std::string_view("a\0b", 3));
+        assert(false);
+    } catch (std::invalid_argument&) {
+        // ok
+    }
+
+    assert(coll.size() == 1);
+}
+
+
+void test() {
+    test_null_character();
+
+    test_builder<vector_facade>();
+    test_builder<bitvector_naive>();
+    test_builder<bitvector_compressed>();
+
+    test_index_file();
+}
+
+
+int main() {
+    test();
+
+    puts("All OK");
+    return EXIT_SUCCESS;
+}
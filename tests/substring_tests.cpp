@@ -0,0 +1,74 @@
+#include "substring.h"
+
+#include <random>
+#include <string>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+
+std::string random_string(std::mt19937& random, size_t n) {
+    // a small alphabet yields many partial matches
+    std::uniform_int_distribution<int> letter('a', 'c');
+
+    std::string s;
+    for (size_t i=0; i < n; i++) {
+        s.push_back(letter(random));
+    }
+
+    return s;
+}
+
+
+void test_kernel(const substring_kernel& kernel) {
+    std::mt19937 random(0);
+
+    for (size_t n=0; n < 150; n++) {
+        for (size_t k=0; k <= n + 1 && k < 70; k++) {
+            for (int trial=0; trial < 4; trial++) {
+                const std::string s = random_string(random, n);
+                std::string needle = random_string(random, k);
+                if (trial == 0 && k <= n) {
+                    // surely present
+                    needle = s.substr(n - k, k);
+                }
+
+                const size_t expected = std::string_view(s).find(needle);
+                const size_t result   = kernel.find(s.data(), s.size(), needle.data(), needle.size());
+                if (expected != result) {
+                    printf("%s failed for '%s' in '%s': %lu != %lu\n",
+                           kernel.name, needle.c_str(), s.c_str(), result, expected);
+                    assert(false);
+                }
+            }
+        }
+    }
+}
+
+
+void test_contains() {
+    assert(substring_contains("warszawa", "szaw"));
+    assert(substring_contains("warszawa", "a"));
+    assert(substring_contains("warszawa", ""));
+    assert(!substring_contains("warszawa", "krakow"));
+    assert(!substring_contains("", "a"));
+    assert(!substring_contains("wars", "warszawa"));
+}
+
+
+void test() {
+    for (const auto& kernel: substring_kernels()) {
+        test_kernel(kernel);
+    }
+
+    test_contains();
+}
+
+
+int main() {
+    test();
+
+    puts("All OK");
+    return EXIT_SUCCESS;
+}
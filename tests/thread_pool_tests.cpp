@@ -0,0 +1,121 @@
+#include <vector>
+#include <string>
+#include <optional>
+#include <atomic>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "ThreadPool.h"
+#include "Builder.h"
+#include "DB.h"
+#include "NaiveDB.h"
+#include "IndexedDB.h"
+#include "combiner/all.h"
+
+#include "bitvector_naive.h"
+
+
+void test_tasks() {
+    for (size_t threads: {1, 2, 4}) {
+        ThreadPool pool(threads);
+        assert(pool.size() == threads);
+
+        std::atomic<size_t> sum{0};
+        for (int round=0; round < 3; round++) {
+            // tasks of very different costs
+            for (size_t i=1; i <= 100; i++) {
+                pool.submit([&sum, i] {
+                    size_t s = 0;
+                    for (size_t j=0; j < (i % 10) * 10000; j++) {
+                        s += j & 1;
+                    }
+                    sum += i + (s & 0);
+                });
+            }
+
+            pool.wait();
+            assert(sum == size_t(round + 1) * 5050);
+        }
+    }
+}
+
+
+void test_for_each_range() {
+    ThreadPool pool(3);
+
+    std::vector<int> visited(1000, 0);
+    pool.for_each_range(visited.size(), 7, [&visited](size_t first, size_t last) {
+        for (size_t i=first; i < last; i++) {
+            visited[i] += 1;
+        }
+    });
+
+    for (const int v: visited) {
+        assert(v == 1);
+    }
+
+    pool.for_each_range(0, 7, [](size_t, size_t) {
+        assert(false);
+    });
+}
+
+
+void test_nested_for_each_range() {
+    ThreadPool pool(2);
+
+    std::atomic<size_t> sum{0};
+    pool.for_each_range(10, 1, [&pool, &sum](size_t, size_t) {
+        pool.for_each_range(10, 1, [&sum](size_t first, size_t) {
+            sum += first;
+        });
+    });
+
+    assert(sum == 10 * 45);
+}
+
+
+void test_concurrent_queries() {
+    Collection coll;
+    for (size_t i=0; i < 2000; i++) {
+        coll.emplace_back("row " + std::to_string(i * 7919 % 10007));
+    }
+
+    Builder<bitvector_naive> builder(coll.size());
+    builder.add(coll);
+    const IndexedDB<AndAll<bitvector_naive>> db(coll, builder.capture());
+
+    std::vector<std::string> queries;
+    for (size_t i=0; i < 500; i++) {
+        queries.push_back(std::to_string(i * 31 % 1000));
+    }
+
+    ThreadPool pool(4);
+    std::vector<int> results(queries.size());
+    pool.for_each_range(queries.size(), 4, [&db, &queries, &results](size_t first, size_t last) {
+        for (size_t i=first; i < last; i++) {
+            results[i] = db.matches(queries[i]);
+        }
+    });
+
+    for (size_t i=0; i < queries.size(); i++) {
+        assert(results[i] == db.matches(queries[i]));
+    }
+}
+
+
+void test() {
+    test_tasks();
+    test_for_each_range();
+    test_nested_for_each_range();
+    test_concurrent_queries();
+}
+
+
+int main() {
+    test();
+
+    puts("All OK");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,174 @@
+#include <vector>
+#include <string>
+#include <optional>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Builder.h"
+#include "DB.h"
+#include "NaiveDB.h"
+#include "IndexedDB.h"
+#include "CachedDB.h"
+#include "ShardedDB.h"
+#include "LiveDB.h"
+#include "combiner/all.h"
+
+#include "bitvector_naive.h"
+#include "bitvector_tracking.h"
+#include "bitvector_sparse.h"
+#include "bitvector_hybrid.h"
+#include "bitvector_compressed.h"
+#include "vector_facade.h"
+#include "deque_facade.h"
+
+#include "common.h"
+
+
+const std::vector<std::string_view> queries = {
+    "", "1", "12", "row", "row 1", "ow 12", "9 1", "123", "0 0", "77", "xyz", " 5", "  "
+};
+
+
+template <typename BITVECTOR>
+void test_visit_batches_until() {
+    const size_t n = 100000;
+    BITVECTOR bv(n);
+    std::vector<uint32_t> expected;
+    for (size_t i=0; i < n; i += 3) {
+        bv.set(i);
+        expected.push_back(i);
+    }
+    bv.update_internal_structures();
+
+    std::vector<uint32_t> ids;
+    size_t calls = 0;
+    bv.visit_batches_until([&ids, &calls](const uint32_t* batch, size_t k) {
+        ids.insert(ids.end(), batch, batch + k);
+        calls += 1;
+        return false;
+    });
+
+    assert(calls == 1);
+    assert(!ids.empty() && ids.size() <= expected.size());
+    assert(std::equal(ids.begin(), ids.end(), expected.begin()));
+
+    ids.clear();
+    bv.visit_batches_until([&ids](const uint32_t* batch, size_t k) {
+        ids.insert(ids.end(), batch, batch + k);
+        return true;
+    });
+    assert(ids == expected);
+}
+
+
+template <typename DBTYPE>
+void test_indexed(const Collection& coll, const NaiveDB& naive) {
+    Builder<typename DBTYPE::bitvector_type> builder(coll.size());
+    builder.add(coll);
+    const DBTYPE db(coll, builder.capture());
+
+    check_words(db, naive, queries);
+    check_words(db, naive, queries); // CachedDB: cached candidates
+}
+
+
+template <typename COMBINER>
+void test_sharded(const Collection& coll, const NaiveDB& naive) {
+    ThreadPool pool(2);
+    const ShardedDB<COMBINER> db(coll, pool, 700);
+
+    check_words(db, naive, queries);
+
+    // rows from the first segments
+    const auto rows = db.find_rows("row", 10);
+    for (size_t i=0; i < rows.size(); i++) {
+        assert(rows[i] == i);
+    }
+}
+
+
+template <typename COMBINER>
+void test_live(const Collection& coll, const NaiveDB& naive) {
+    LiveDB<COMBINER> db(500);
+    for (const auto row: coll) {
+        db.insert(row);
+    }
+
+    check_words(db, naive, queries);
+    db.compact();
+    check_words(db, naive, queries);
+
+    // deleted rows are not visited
+    for (const size_t row: db.find_rows("row 1")) {
+        db.remove(row);
+    }
+    assert(db.find_rows("row 1").empty());
+    assert(db.find_rows("row 1", 1).empty());
+}
+
+
+// Trigrams of "abcde" are common, the word is rare: limited queries
+// intersect long posting lists instead of verifying them.
+void test_common_trigrams() {
+    Collection coll;
+    for (size_t i=0; i < 3 * Index<vector_facade>::verify_cheapest_limit; i++) {
+        coll.emplace_back((i % 1000 == 999) ? "x abcde" : (i % 2 == 0) ? "abcd bcde" : "bcde abcd");
+    }
+
+    const NaiveDB naive(coll);
+    const std::string_view word = "abcde";
+
+    Builder<vector_facade> builder(coll.size());
+    builder.add(coll);
+    const IndexedDB<AndAll<vector_facade>> indexed(coll, builder.capture());
+
+    ThreadPool pool(2);
+    const ShardedDB<AndAll<vector_facade>> sharded(coll, pool, 5000);
+
+    LiveDB<AndAll<vector_facade>> live(5000);
+    for (const auto row: coll) {
+        live.insert(row);
+    }
+
+    for (const DB* db: std::initializer_list<const DB*>{&indexed, &sharded, &live}) {
+        for (const size_t limit: {size_t(1), size_t(5), DB::unlimited}) {
+            check_rows(db->find_rows(word, limit), naive.find_rows(word), limit);
+        }
+    }
+}
+
+
+void test() {
+    test_visit_batches_until<bitvector_naive>();
+    test_visit_batches_until<bitvector_tracking>();
+    test_visit_batches_until<bitvector_sparse>();
+    test_visit_batches_until<bitvector_hybrid>();
+    test_visit_batches_until<bitvector_compressed>();
+    test_visit_batches_until<vector_facade>();
+    test_visit_batches_until<deque_facade>();
+
+    const Collection coll = sample_collection(3000);
+    const NaiveDB naive(coll);
+
+    check_words(naive, naive, queries);
+
+    test_indexed<IndexedDB<AndAll<vector_facade>>>(coll, naive);
+    test_indexed<IndexedDB<CostBased<bitvector_naive>>>(coll, naive);
+    test_indexed<IndexedDB<AndAll<bitvector_compressed>>>(coll, naive);
+    test_indexed<CachedDB<AndAll<vector_facade>>>(coll, naive);
+
+    test_sharded<AndAll<vector_facade>>(coll, naive);
+    test_live<AndAll<vector_facade>>(coll, naive);
+
+    test_common_trigrams();
+}
+
+
+int main() {
+    test();
+
+    puts("All OK");
+    return EXIT_SUCCESS;
+}